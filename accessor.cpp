@@ -40,7 +40,7 @@ namespace json
             std::destroy_at(&itObject);
     }
     
-    const string& Value::Accessor::key()
+    string_view Value::Accessor::key()
     {
         if (toArray)
             throw runtime_error("Accessor does not point to an object element, yet key() was called on it");
@@ -84,7 +84,7 @@ namespace json
 #endif
     }
     
-    const string& Value::ConstAccessor::key()
+    string_view Value::ConstAccessor::key()
     {
         if (toArray)
             throw runtime_error("ConstAccessor does not point to an object element, yet key() was called on it");
@@ -0,0 +1,97 @@
+//
+//  arena.cpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#include <algorithm>
+#include <cstdint>
+
+#include "arena.hpp"
+
+using namespace std;
+
+namespace json
+{
+    //! The space taken by the header of a block, so that the memory after it is aligned for anything
+    static constexpr size_t blockHeaderSize = (sizeof(void*) + sizeof(size_t) + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t);
+    
+    Arena::Arena(size_t blockSize) :
+        nextBlockSize(max<size_t>(blockSize, 256))
+    {
+        
+    }
+    
+    Arena::~Arena()
+    {
+        while (head)
+        {
+            auto previous = head->previous;
+            ::operator delete(head);
+            head = previous;
+        }
+    }
+    
+    void* Arena::allocate(size_t size, size_t alignment)
+    {
+        // Round the cursor up to the alignment, which is a power of two
+        auto address = reinterpret_cast<uintptr_t>(cursor);
+        auto padding = (alignment - address % alignment) % alignment;
+        
+        if (!cursor || size + padding > static_cast<size_t>(end - cursor))
+        {
+            // New blocks are aligned for anything, so they need no padding
+            grow(size);
+            padding = 0;
+        }
+        
+        auto pointer = cursor + padding;
+        cursor = pointer + size;
+        used += size + padding;
+        
+        return pointer;
+    }
+    
+    void Arena::release()
+    {
+        if (!head)
+            return;
+        
+        // An arena that needed several blocks gets a single one as large as all of them together,
+        // so that the same amount fits in it the next time around
+        if (head->previous)
+        {
+            const auto total = capacity;
+            while (head)
+            {
+                auto previous = head->previous;
+                ::operator delete(head);
+                head = previous;
+            }
+            
+            capacity = 0;
+            grow(total - blockHeaderSize);
+        }
+        
+        cursor = reinterpret_cast<char*>(head) + blockHeaderSize;
+        used = 0;
+    }
+    
+    void Arena::grow(size_t minimum)
+    {
+        const auto blockSize = max(nextBlockSize, minimum + blockHeaderSize);
+        
+        auto block = new (::operator new(blockSize)) Block;
+        block->previous = head;
+        block->size = blockSize;
+        
+        head = block;
+        cursor = reinterpret_cast<char*>(block) + blockHeaderSize;
+        end = reinterpret_cast<char*>(block) + blockSize;
+        
+        capacity += blockSize;
+        nextBlockSize = min(nextBlockSize * 2, maxBlockSize);
+    }
+}
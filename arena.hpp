@@ -0,0 +1,151 @@
+//
+//  arena.hpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#ifndef JSON_ARENA_HPP
+#define JSON_ARENA_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+namespace json
+{
+    //! Hands out memory from large blocks, which is only freed all at once
+    /*! Allocating is a matter of moving a pointer forward, and releasing the arena frees everything that
+        was allocated from it without visiting any of it. This suits documents that are parsed, read and
+        thrown away as a whole (see json::parse(std::string_view, Arena&, const ParseOptions&)).
+        
+        An arena can be used by one thread at a time. */
+    class Arena
+    {
+    public:
+        //! Construct the arena, without allocating anything yet
+        /*! @param blockSize The size of the first block. Every next block is twice as large, up to maxBlockSize. */
+        explicit Arena(std::size_t blockSize = 64 * 1024);
+        
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+        
+        //! Free all blocks
+        ~Arena();
+        
+        //! Allocate memory, which stays valid until the arena is released or destructed
+        /*! @param alignment A power of two, no larger than alignof(std::max_align_t) */
+        void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+        
+        //! Free everything that was allocated from the arena at once
+        /*! One block is kept, as large as all blocks were together, so that an arena that is used over and
+            over stops allocating once it has grown large enough.
+            @warning Values allocated from the arena should have been destructed or reset beforehand */
+        void release();
+        
+        //! Return the number of bytes allocated from the arena since it was last released
+        std::size_t getSize() const { return used; }
+        
+        //! Return the number of bytes in the blocks that the arena holds on to
+        std::size_t getCapacity() const { return capacity; }
+        
+    public:
+        //! The size of the blocks beyond which they stop doubling
+        static constexpr std::size_t maxBlockSize = 16 * 1024 * 1024;
+        
+    private:
+        //! Precedes the memory of every block
+        struct Block
+        {
+            //! The block that was allocated before this one
+            Block* previous = nullptr;
+            
+            //! The size of the block, including this header
+            std::size_t size = 0;
+        };
+        
+    private:
+        //! Allocate a block that holds at least a number of bytes, and continue allocating from it
+        void grow(std::size_t minimum);
+        
+    private:
+        //! The block that is being allocated from, which links to the others
+        Block* head = nullptr;
+        
+        //! The next free byte in the head block, and the end of it
+        char* cursor = nullptr;
+        char* end = nullptr;
+        
+        //! The size of the next block to allocate
+        std::size_t nextBlockSize = 0;
+        
+        //! The number of bytes allocated since the last release, and the number of bytes in the blocks
+        std::size_t used = 0;
+        std::size_t capacity = 0;
+    };
+    
+    //! Allocates for standard containers from an arena, or from the heap if it has none
+    /*! Memory from an arena is never deallocated individually. Copying a container that uses this
+        allocator yields one that allocates from the heap, so that copies can outlive the arena. */
+    template <class T>
+    class Allocator
+    {
+        template <class U>
+        friend class Allocator;
+        
+    public:
+        using value_type = T;
+        using propagate_on_container_copy_assignment = std::false_type;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+        
+    public:
+        //! Allocate from the heap
+        Allocator() noexcept = default;
+        
+        //! Allocate from an arena, or from the heap if it's a nullptr
+        Allocator(Arena* arena) noexcept :
+            arena(arena)
+        {
+            
+        }
+        
+        template <class U>
+        Allocator(const Allocator<U>& rhs) noexcept :
+            arena(rhs.arena)
+        {
+            
+        }
+        
+        T* allocate(std::size_t count)
+        {
+            if (arena)
+                return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+            
+            return static_cast<T*>(::operator new(count * sizeof(T)));
+        }
+        
+        void deallocate(T* pointer, std::size_t count) noexcept
+        {
+            if (!arena)
+                ::operator delete(pointer);
+        }
+        
+        Allocator select_on_container_copy_construction() const noexcept { return {}; }
+        
+        //! Return the arena allocated from, or nullptr for the heap
+        Arena* getArena() const noexcept { return arena; }
+        
+        template <class U>
+        bool operator==(const Allocator<U>& rhs) const noexcept { return arena == rhs.arena; }
+        
+        template <class U>
+        bool operator!=(const Allocator<U>& rhs) const noexcept { return arena != rhs.arena; }
+        
+    private:
+        Arena* arena = nullptr;
+    };
+}
+
+#endif
@@ -0,0 +1,114 @@
+//
+//  builder.hpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "arena.hpp"
+#include "handler.hpp"
+#include "value.hpp"
+
+namespace json
+{
+    //! Builds a Value out of the events of the parser
+    /*! Final, so that the parser calls its events directly when it knows it's building a Value */
+    class ValueBuilder final :
+        public Handler
+    {
+    public:
+        //! @param arena The arena to allocate long strings, arrays and objects from, or nullptr for the heap
+        ValueBuilder(Value& root, Arena* arena = nullptr) :
+            root(root),
+            arena(arena)
+        {
+            
+        }
+        
+        void startObject() override { open<Value::Object>(); }
+        void key(std::string_view key) override;
+        void endObject() override { containers.pop_back(); }
+        void startArray() override { open<Value::Array>(); }
+        void endArray() override { containers.pop_back(); }
+        void string(std::string_view string) override;
+        void int64(std::int64_t number) override { next() = number; }
+        void uint64(std::uint64_t number) override { next() = number; }
+        void real(Real number) override { next() = number; }
+        void boolean(bool boolean) override { next() = boolean; }
+        void null() override { next() = Value::Null{}; }
+        
+        //! Forget about the value being built, to start on a new one
+        void reset()
+        {
+            target = nullptr;
+            containers.clear();
+        }
+        
+    private:
+        //! Start an array or object, as the next value
+        template <class Container>
+        void open()
+        {
+            auto& value = next();
+            if (arena)
+                value = Value(Container{}, *arena);
+            else
+                value = Container{};
+            
+            containers.push_back(&value);
+        }
+        
+        //! Return where the next value goes
+        /*! That is straight into its container, so that it is never copied. Containers are filled through
+            their storage directly, rather than through the accessors that mark arena containers as modified. */
+        Value& next()
+        {
+            if (containers.empty())
+                return root;
+            
+            if (containers.back()->isArray())
+                return containers.back()->getArray().emplace_back();
+            
+            return *target;
+        }
+        
+    private:
+        Value& root;
+        
+        //! Where long strings, arrays and objects are allocated, or nullptr for the heap
+        Arena* arena = nullptr;
+        
+        //! The element of the innermost object that the last key was inserted as
+        Value* target = nullptr;
+        
+        //! The arrays and objects being built, innermost last
+        std::vector<Value*> containers;
+    };
+    
+    inline void ValueBuilder::key(std::string_view key)
+    {
+        // A key that appeared before has its value replaced, so the last one wins
+        auto result = containers.back()->getObject().try_emplace(key);
+        if (!result.second)
+            result.first->second = Value::Null{};
+        
+        target = &result.first->second;
+    }
+    
+    inline void ValueBuilder::string(std::string_view string)
+    {
+        if (arena)
+            next() = Value(string, *arena);
+        else
+            next() = string;
+    }
+}
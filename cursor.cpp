@@ -0,0 +1,330 @@
+//
+//  cursor.cpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#include <stdexcept>
+#include <utility>
+
+#include "cursor.hpp"
+#include "error.hpp"
+
+using namespace std;
+
+namespace json
+{
+    Cursor::Cursor(string_view text, const ParseOptions& options) :
+        lexer(text),
+        parser(lexer),
+        acceptCommaAfterLastEntry(options.acceptCommaAfterLastEntry),
+        maxDepth(options.maxDepth)
+    {
+        lexer.acceptComments = options.acceptComments;
+        lexer.validateUtf8 = options.validateUtf8;
+        parser.acceptCommaAfterLastEntry = options.acceptCommaAfterLastEntry;
+        
+        current = lexer.getNextToken();
+    }
+    
+    Cursor::Cursor(istream& stream, const ParseOptions& options) :
+        lexer(stream),
+        parser(lexer),
+        acceptCommaAfterLastEntry(options.acceptCommaAfterLastEntry),
+        maxDepth(options.maxDepth)
+    {
+        lexer.acceptComments = options.acceptComments;
+        lexer.validateUtf8 = options.validateUtf8;
+        parser.acceptCommaAfterLastEntry = options.acceptCommaAfterLastEntry;
+        
+        current = lexer.getNextToken();
+    }
+    
+    bool Cursor::isNull() const { return !consumed && current.type == Token::Type::NIL; }
+    bool Cursor::isBool() const { return !consumed && (current.type == Token::Type::BOOL_TRUE || current.type == Token::Type::BOOL_FALSE); }
+    bool Cursor::isNumber() const { return !consumed && current.type == Token::Type::NUMBER; }
+    bool Cursor::isString() const { return !consumed && current.type == Token::Type::STRING; }
+    bool Cursor::isArray() const { return !consumed && current.type == Token::Type::LEFT_SQUARE_BRACKET; }
+    bool Cursor::isObject() const { return !consumed && current.type == Token::Type::LEFT_ACCOLADE; }
+    
+    bool Cursor::asBool()
+    {
+        read(isBool(), "Json value is not a boolean, yet asBool() was called on it");
+        return current.type == Token::Type::BOOL_TRUE;
+    }
+    
+    int64_t Cursor::asSignedInteger()
+    {
+        read(isNumber(), "Json value is not a number, yet asSignedInteger() was called on it");
+        switch (current.numberType)
+        {
+            case Token::NumberType::SIGNED: return current.signedInteger;
+            case Token::NumberType::UNSIGNED: return static_cast<int64_t>(current.unsignedInteger);
+            case Token::NumberType::REAL: default: return static_cast<int64_t>(current.real);
+        }
+    }
+    
+    uint64_t Cursor::asUnsignedInteger()
+    {
+        read(isNumber(), "Json value is not a number, yet asUnsignedInteger() was called on it");
+        switch (current.numberType)
+        {
+            case Token::NumberType::SIGNED: return static_cast<uint64_t>(current.signedInteger);
+            case Token::NumberType::UNSIGNED: return current.unsignedInteger;
+            case Token::NumberType::REAL: default: return static_cast<uint64_t>(current.real);
+        }
+    }
+    
+    Real Cursor::asReal()
+    {
+        read(isNumber(), "Json value is not a number, yet asReal() was called on it");
+        switch (current.numberType)
+        {
+            case Token::NumberType::SIGNED: return static_cast<Real>(current.signedInteger);
+            case Token::NumberType::UNSIGNED: return static_cast<Real>(current.unsignedInteger);
+            case Token::NumberType::REAL: default: return current.real;
+        }
+    }
+    
+    string_view Cursor::asString()
+    {
+        read(isString(), "Json value is not a string, yet asString() was called on it");
+        return current.lexeme;
+    }
+    
+    Value Cursor::asValue()
+    {
+        read(true, "");
+        
+        // The value may be nested already, which counts towards the maximum depth
+        parser.maxDepth = maxDepth > depth ? maxDepth - depth : 0;
+        
+        auto result = parser.tryParse(current);
+        if (!result)
+            throw Error(result.error);
+        
+        return std::move(result.value);
+    }
+    
+    void Cursor::skip()
+    {
+        if (consumed)
+            return;
+        
+        switch (current.type)
+        {
+            case Token::Type::LEFT_ACCOLADE:
+            case Token::Type::LEFT_SQUARE_BRACKET:
+                if (const auto closing = lexer.skipContainer(); closing.type == Token::Type::END_OF_FILE)
+                    fail(closing, ErrorCode::UNEXPECTED_END_OF_INPUT);
+                
+                break;
+            
+            case Token::Type::STRING:
+            case Token::Type::NUMBER:
+            case Token::Type::BOOL_TRUE:
+            case Token::Type::BOOL_FALSE:
+            case Token::Type::NIL:
+                break;
+            
+            default:
+                fail(current, ErrorCode::UNEXPECTED_TOKEN);
+        }
+        
+        consumed = true;
+    }
+    
+    Cursor::Object Cursor::getObject()
+    {
+        read(isObject(), "Json value is not an object, yet getObject() was called on it");
+        if (depth >= maxDepth)
+            fail(current, ErrorCode::TOO_DEEP);
+        
+        return Object(*this, ++depth);
+    }
+    
+    Cursor::Array Cursor::getArray()
+    {
+        read(isArray(), "Json value is not an array, yet getArray() was called on it");
+        if (depth >= maxDepth)
+            fail(current, ErrorCode::TOO_DEEP);
+        
+        return Array(*this, ++depth);
+    }
+    
+    void Cursor::read(bool matches, const char* message)
+    {
+        if (consumed)
+            throw runtime_error("Json value at the cursor was already read");
+        
+        // Report tokens that aren't values at all, such as lexing errors, as syntax errors
+        switch (current.type)
+        {
+            case Token::Type::LEFT_ACCOLADE:
+            case Token::Type::LEFT_SQUARE_BRACKET:
+            case Token::Type::STRING:
+            case Token::Type::NUMBER:
+            case Token::Type::BOOL_TRUE:
+            case Token::Type::BOOL_FALSE:
+            case Token::Type::NIL:
+                break;
+            
+            default:
+                fail(current, ErrorCode::UNEXPECTED_TOKEN);
+        }
+        
+        if (!matches)
+            throw runtime_error(message);
+        
+        consumed = true;
+    }
+    
+    void Cursor::unwind(size_t target)
+    {
+        skip();
+        
+        // Containers that were entered, but not iterated to their end, are left by skipping what remains of them.
+        // Whatever was entered inside those is balanced, so bracket matching lands on their closing bracket.
+        for (; depth > target; --depth)
+        {
+            if (const auto closing = lexer.skipContainer(); closing.type == Token::Type::END_OF_FILE)
+                fail(closing, ErrorCode::UNEXPECTED_END_OF_INPUT);
+        }
+    }
+    
+    bool Cursor::nextField(Object& object, string_view wanted, bool any)
+    {
+        if (object.finished || depth < object.depth)
+            return false;
+        
+        while (true)
+        {
+            unwind(object.depth);
+            
+            auto token = lexer.getNextToken();
+            auto closes = token.type == Token::Type::RIGHT_ACCOLADE;
+            if (!object.first && !closes)
+            {
+                if (token.type != Token::Type::COMMA)
+                    fail(token, ErrorCode::EXPECTED_OBJECT_SEPARATOR);
+                
+                token = lexer.getNextToken();
+                closes = acceptCommaAfterLastEntry && token.type == Token::Type::RIGHT_ACCOLADE;
+            }
+            
+            if (closes)
+            {
+                object.finished = true;
+                --depth;
+                return false;
+            }
+            
+            object.first = false;
+            
+            if (token.type != Token::Type::STRING)
+                fail(token, ErrorCode::EXPECTED_KEY);
+            
+            // The lexeme is only valid until the next token, so compare the key before reading on
+            const auto found = any || token.lexeme == wanted;
+            if (found)
+                key.assign(token.lexeme);
+            
+            if (const auto colon = lexer.getNextToken(); colon.type != Token::Type::COLON)
+                fail(colon, ErrorCode::EXPECTED_COLON);
+            
+            current = lexer.getNextToken();
+            consumed = false;
+            
+            if (found)
+                return true;
+        }
+    }
+    
+    bool Cursor::nextElement(Array& array)
+    {
+        if (array.finished || depth < array.depth)
+            return false;
+        
+        unwind(array.depth);
+        
+        auto token = lexer.getNextToken();
+        auto closes = token.type == Token::Type::RIGHT_SQUARE_BRACKET;
+        if (!array.first && !closes)
+        {
+            if (token.type != Token::Type::COMMA)
+                fail(token, ErrorCode::EXPECTED_ARRAY_SEPARATOR);
+            
+            token = lexer.getNextToken();
+            closes = acceptCommaAfterLastEntry && token.type == Token::Type::RIGHT_SQUARE_BRACKET;
+        }
+        
+        if (closes)
+        {
+            array.finished = true;
+            --depth;
+            return false;
+        }
+        
+        array.first = false;
+        current = token;
+        consumed = false;
+        return true;
+    }
+    
+    void Cursor::fail(const Token& token, ErrorCode code)
+    {
+        // Running out of input, or into something the lexer didn't understand, is the more precise explanation
+        if (token.type == Token::Type::END_OF_FILE)
+            code = ErrorCode::UNEXPECTED_END_OF_INPUT;
+        else if (token.type == Token::Type::UNKNOWN)
+            code = token.error;
+        
+        ParseError error;
+        error.code = code;
+        error.offset = token.offset;
+        
+        const auto position = lexer.getPosition(token.offset);
+        error.line = position.line;
+        error.character = position.character;
+        
+        // The value at the cursor can't be read any more
+        consumed = true;
+        throw Error(error);
+    }
+    
+    Cursor::Object::Object(Cursor& cursor, size_t depth) :
+        cursor(&cursor),
+        depth(depth)
+    {
+        
+    }
+    
+    bool Cursor::Object::findField(string_view key)
+    {
+        return cursor->nextField(*this, key, false);
+    }
+    
+    bool Cursor::Object::nextField()
+    {
+        return cursor->nextField(*this, {}, true);
+    }
+    
+    const string& Cursor::Object::getKey() const
+    {
+        return cursor->key;
+    }
+    
+    Cursor::Array::Array(Cursor& cursor, size_t depth) :
+        cursor(&cursor),
+        depth(depth)
+    {
+        
+    }
+    
+    bool Cursor::Array::nextElement()
+    {
+        return cursor->nextElement(*this);
+    }
+}
@@ -0,0 +1,213 @@
+//
+//  cursor.hpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#ifndef JSON_CURSOR_HPP
+#define JSON_CURSOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+
+#include "lexer.hpp"
+#include "parse.hpp"
+#include "parser.hpp"
+#include "token.hpp"
+#include "value.hpp"
+
+namespace json
+{
+    //! Reads Json on demand, converting only the values that are asked for
+    /*! The cursor moves forward through the input, one value at a time. Arrays and objects are entered
+        with getArray() and getObject(), which return a handle to step through their elements. Whatever
+        is stepped over without being read is skipped by matching brackets, instead of being parsed.
+        
+        Because the cursor only moves forward, fields are found in the order in which they appear in the
+        input. Syntax errors are only detected in the parts that are read, and throw json::Error then.
+        
+        @code
+        json::Cursor cursor(text);
+        auto root = cursor.getObject();
+        if (root.findField("id"))
+            id = cursor.asSignedInteger();
+        @endcode */
+    class Cursor
+    {
+    public:
+        class Object;
+        class Array;
+        
+    public:
+        //! Read from a contiguous block of text
+        /*! @warning The text should outlive the cursor */
+        Cursor(std::string_view text, const ParseOptions& options = {});
+        
+        //! Read from a stream
+        Cursor(std::istream& stream, const ParseOptions& options = {});
+        
+        Cursor(const Cursor&) = delete;
+        Cursor& operator=(const Cursor&) = delete;
+        
+        // Inspect the value at the cursor, without reading it. All of these are false once it has been read.
+        bool isNull() const; //!< Is the value at the cursor a null?
+        bool isBool() const; //!< Is the value at the cursor a boolean?
+        bool isNumber() const; //!< Is the value at the cursor a number?
+        bool isString() const; //!< Is the value at the cursor a string?
+        bool isArray() const; //!< Is the value at the cursor an array?
+        bool isObject() const; //!< Is the value at the cursor an object?
+        
+        //! Read the value at the cursor as a boolean
+        /*! @throw std::runtime_error if the value is not a boolean */
+        bool asBool();
+        
+        //! Read the value at the cursor as a signed integer
+        /*! @throw std::runtime_error if the value is not a number */
+        std::int64_t asSignedInteger();
+        
+        //! Read the value at the cursor as an unsigned integer
+        /*! @throw std::runtime_error if the value is not a number */
+        std::uint64_t asUnsignedInteger();
+        
+        //! Read the value at the cursor as a real number
+        /*! @throw std::runtime_error if the value is not a number */
+        Real asReal();
+        
+        //! Read the value at the cursor as a string
+        /*! @throw std::runtime_error if the value is not a string
+            @warning The string is only valid until the cursor moves on */
+        std::string_view asString();
+        
+        //! Parse the value at the cursor, and everything in it
+        Value asValue();
+        
+        //! Skip the value at the cursor without reading it
+        void skip();
+        
+        //! Enter the object at the cursor
+        /*! @throw std::runtime_error if the value is not an object */
+        Object getObject();
+        
+        //! Enter the array at the cursor
+        /*! @throw std::runtime_error if the value is not an array */
+        Array getArray();
+        
+    private:
+        //! Check the value at the cursor before reading it, and mark it as read
+        /*! @param matches Is the value of the type that the caller expects?
+            @param message What to throw if it isn't */
+        void read(bool matches, const char* message);
+        
+        //! Skip whatever is left of the value at the cursor, and of the containers entered below a depth
+        void unwind(std::size_t target);
+        
+        //! Move to the next field of an object
+        /*! @param wanted The key to look for, skipping the fields before it
+            @param any Do we move to the next field, regardless of its key?
+            @return false if the object has ended */
+        bool nextField(Object& object, std::string_view wanted, bool any);
+        
+        //! Move to the next element of an array
+        /*! @return false if the array has ended */
+        bool nextElement(Array& array);
+        
+        //! Throw the error of a token
+        [[noreturn]] void fail(const Token& token, ErrorCode code);
+        
+    private:
+        Lexer lexer;
+        
+        //! Parses the values requested by asValue()
+        Parser parser;
+        
+        //! Do we accept a comma after the last entry of an object or array?
+        bool acceptCommaAfterLastEntry = true;
+        
+        //! The maximum number of arrays and objects that can be nested in each other
+        std::size_t maxDepth = 1024;
+        
+        //! The first token of the value at the cursor
+        Token current;
+        
+        //! Has the value at the cursor been read (or skipped, or entered)?
+        bool consumed = false;
+        
+        //! The number of arrays and objects that have been entered, but not left
+        std::size_t depth = 0;
+        
+        //! The key of the last field that was moved to
+        std::string key;
+    };
+    
+    //! An object entered by a cursor, through which its fields are found
+    /*! Moving to another field first skips whatever is left of the current one. The handle becomes
+        invalid once the object containing it moves on. */
+    class Cursor::Object
+    {
+    public:
+        //! Move the cursor to the value of a field, skipping the fields before it
+        /*! Only the fields after the one last moved to are searched.
+            @return false if the object ends before the field is found */
+        bool findField(std::string_view key);
+        
+        //! Move the cursor to the value of the next field
+        /*! @return false if the object has ended */
+        bool nextField();
+        
+        //! Return the key of the field that was last moved to
+        /*! @warning This is only valid until the cursor moves to another field */
+        const std::string& getKey() const;
+        
+    private:
+        friend class Cursor;
+        
+        Object(Cursor& cursor, std::size_t depth);
+        
+    private:
+        Cursor* cursor = nullptr;
+        
+        //! The depth of the cursor inside this object
+        std::size_t depth = 0;
+        
+        //! Haven't we moved to any field yet?
+        bool first = true;
+        
+        //! Has the closing bracket been read?
+        bool finished = false;
+    };
+    
+    //! An array entered by a cursor, through which its elements are visited
+    /*! Moving to the next element first skips whatever is left of the current one. The handle becomes
+        invalid once the array or object containing it moves on. */
+    class Cursor::Array
+    {
+    public:
+        //! Move the cursor to the next element
+        /*! @return false if the array has ended */
+        bool nextElement();
+        
+    private:
+        friend class Cursor;
+        
+        Array(Cursor& cursor, std::size_t depth);
+        
+    private:
+        Cursor* cursor = nullptr;
+        
+        //! The depth of the cursor inside this array
+        std::size_t depth = 0;
+        
+        //! Haven't we moved to any element yet?
+        bool first = true;
+        
+        //! Has the closing bracket been read?
+        bool finished = false;
+    };
+}
+
+#endif
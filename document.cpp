@@ -0,0 +1,53 @@
+//
+//  document.cpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#include "document.hpp"
+
+using namespace std;
+
+namespace json
+{
+    Document::Document(const ParseOptions& options) :
+        lexer(string_view()),
+        parser(lexer),
+        builder(value, &arena)
+    {
+        lexer.acceptComments = options.acceptComments;
+        lexer.validateUtf8 = options.validateUtf8;
+        parser.acceptCommaAfterLastEntry = options.acceptCommaAfterLastEntry;
+        parser.maxDepth = options.maxDepth;
+    }
+    
+    Value& Document::parse(string_view text)
+    {
+        if (const auto error = tryParse(text))
+            throw Error(error);
+        
+        return value;
+    }
+    
+    ParseError Document::tryParse(string_view text)
+    {
+        clear();
+        
+        lexer.reset(text);
+        
+        const auto error = parser.tryParse(builder);
+        if (error)
+            clear();
+        
+        return error;
+    }
+    
+    void Document::clear()
+    {
+        // Unless it was changed, the value is in the arena entirely, so that this doesn't visit any of it
+        value = Value::null;
+        arena.release();
+    }
+}
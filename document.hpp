@@ -0,0 +1,82 @@
+//
+//  document.hpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#ifndef JSON_DOCUMENT_HPP
+#define JSON_DOCUMENT_HPP
+
+#include <cstddef>
+#include <string_view>
+
+#include "arena.hpp"
+#include "builder.hpp"
+#include "error.hpp"
+#include "lexer.hpp"
+#include "parse.hpp"
+#include "parser.hpp"
+#include "value.hpp"
+
+namespace json
+{
+    //! Parses one Json text after another, reusing all of its memory between them
+    /*! Made for services that parse many similar messages. The value is allocated from an arena that the
+        document owns, which is released at once before the next parse. The lexer's scratch space and the
+        parser's stack are kept as well, so that once the document has parsed a message of some size,
+        parsing the next one that isn't larger doesn't allocate at all.
+        
+        The value belongs to the document, and is replaced by the next parse. Copy it to keep it around.
+        
+        @code
+        json::Document document;
+        while (receive(message))
+            handle(document.parse(message));
+        @endcode */
+    class Document
+    {
+    public:
+        //! Construct an empty document, whose value is null
+        /*! Parsing a document never uses threads, so the parallel options are ignored */
+        explicit Document(const ParseOptions& options = {});
+        
+        Document(const Document&) = delete;
+        Document& operator=(const Document&) = delete;
+        
+        //! Parse text, replacing the value that the document held
+        /*! The text doesn't need to outlive the parse, as the value holds copies of its strings
+            @return The parsed value
+            @throw json::Error (a std::runtime_error) in case of parsing errors, after which the value is null */
+        Value& parse(std::string_view text);
+        
+        //! Parse text, replacing the value that the document held, without throwing in case of parsing errors
+        /*! @return What went wrong, if anything, in which case the value is null */
+        ParseError tryParse(std::string_view text);
+        
+        //! Return the value that was parsed last
+        /*! It can be changed, but should not be moved out of the document, as it's allocated from its arena */
+        Value& getValue() { return value; }
+        const Value& getValue() const { return value; }
+        
+        //! Reset the value to null, and release what was allocated for it
+        void clear();
+        
+        //! Return the number of bytes the document holds on to for the values it parses
+        std::size_t getCapacity() const { return arena.getCapacity(); }
+        
+    private:
+        //! Where the value is allocated, which should outlive it
+        Arena arena;
+        
+        //! The value that was parsed last
+        Value value;
+        
+        Lexer lexer;
+        Parser parser;
+        ValueBuilder builder;
+    };
+}
+
+#endif
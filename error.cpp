@@ -9,6 +9,27 @@
 
 namespace json
 {
+    const char* getDescription(ErrorCode code)
+    {
+        switch (code)
+        {
+            case ErrorCode::NONE: return "No error";
+            case ErrorCode::UNEXPECTED_TOKEN: return "Unexpected token";
+            case ErrorCode::UNEXPECTED_END_OF_INPUT: return "Unexpected end of input";
+            case ErrorCode::INVALID_NUMBER: return "Invalid number";
+            case ErrorCode::UNTERMINATED_STRING: return "Unterminated string";
+            case ErrorCode::INVALID_UNICODE_ESCAPE: return "Invalid \\u escape sequence";
+            case ErrorCode::INVALID_UTF8: return "String contains invalid UTF-8";
+            case ErrorCode::EXPECTED_KEY: return "Expected a string as object key";
+            case ErrorCode::EXPECTED_COLON: return "Expected : after an object key";
+            case ErrorCode::EXPECTED_OBJECT_SEPARATOR: return "Object fields must be seperated by ,";
+            case ErrorCode::EXPECTED_ARRAY_SEPARATOR: return "Array fields must be seperated by ,";
+            case ErrorCode::TOO_DEEP: return "Arrays and objects are nested too deeply";
+        }
+        
+        return "Unknown error";
+    }
+    
     Error::Error(std::size_t line, std::size_t character, std::string_view message) :
         std::runtime_error(std::to_string(line) + ":" + std::to_string(character) + " " + std::string(message)),
         line(line),
@@ -18,6 +39,12 @@ namespace json
         
     }
     
+    Error::Error(const ParseError& error) :
+        Error(error.line, error.character, getDescription(error.code))
+    {
+        code = error.code;
+    }
+    
     std::size_t Error::getLine() const
     {
         return line;
@@ -32,4 +59,9 @@ namespace json
     {
         return message;
     }
+    
+    ErrorCode Error::getCode() const
+    {
+        return code;
+    }
 }
@@ -15,20 +15,61 @@
 
 namespace json
 {
+    //! The reasons parsing can fail
+    enum class ErrorCode
+    {
+        NONE,
+        UNEXPECTED_TOKEN,
+        UNEXPECTED_END_OF_INPUT,
+        INVALID_NUMBER,
+        UNTERMINATED_STRING,
+        INVALID_UNICODE_ESCAPE,
+        INVALID_UTF8,
+        EXPECTED_KEY,
+        EXPECTED_COLON,
+        EXPECTED_OBJECT_SEPARATOR,
+        EXPECTED_ARRAY_SEPARATOR,
+        TOO_DEEP
+    };
+    
+    //! Return a human-readable description of an error code
+    const char* getDescription(ErrorCode code);
+    
+    //! Describes why and where parsing failed, without the cost of an exception
+    struct ParseError
+    {
+        //! Did parsing fail?
+        explicit operator bool() const { return code != ErrorCode::NONE; }
+        
+        ErrorCode code = ErrorCode::NONE;
+        
+        //! The byte offset into the input
+        std::size_t offset = 0;
+        
+        //! The zero-based line and character of the offset
+        std::size_t line = 0;
+        std::size_t character = 0;
+    };
+    
     class Error :
         public std::runtime_error
     {
     public:
         Error(std::size_t line, std::size_t character, std::string_view message);
+        Error(const ParseError& error);
         
         std::size_t getLine() const;
         std::size_t getCharacter() const;
         const std::string& getMessage() const;
         
+        //! Return the error code, or ErrorCode::NONE if the error wasn't raised by the parser
+        ErrorCode getCode() const;
+        
     private:
         std::size_t line = 0;
         std::size_t character = 0;
         std::string message;
+        ErrorCode code = ErrorCode::NONE;
     };
 }
 
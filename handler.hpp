@@ -0,0 +1,67 @@
+//
+//  handler.hpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#ifndef JSON_HANDLER_HPP
+#define JSON_HANDLER_HPP
+
+#include <cstdint>
+#include <string_view>
+
+#include "real.hpp"
+
+namespace json
+{
+    //! Base class for receiving Json as a sequence of events while it is parsed
+    /*! This avoids building a Value, so that input of any size can be processed in constant memory.
+        All events do nothing by default, so derivatives only need to override those they're interested in.
+        @see json::parse(std::istream&, Handler&, const ParseOptions&) */
+    class Handler
+    {
+    public:
+        //! Virtual destructor, because this is a polymorphic class
+        virtual ~Handler() = default;
+        
+        //! An object starts, followed by alternating keys and values until endObject()
+        virtual void startObject() { }
+        
+        //! The key of the next value in an object
+        /*! @warning The key is only valid for the duration of the call */
+        virtual void key(std::string_view key) { }
+        
+        //! The innermost object ends
+        virtual void endObject() { }
+        
+        //! An array starts, followed by its values until endArray()
+        virtual void startArray() { }
+        
+        //! The innermost array ends
+        virtual void endArray() { }
+        
+        //! A string value, unescaped
+        /*! @warning The string is only valid for the duration of the call */
+        virtual void string(std::string_view string) { }
+        
+        //! An integer number that fits a signed 64-bit integer
+        virtual void int64(std::int64_t number) { }
+        
+        //! A positive integer number that only fits an unsigned 64-bit integer
+        virtual void uint64(std::uint64_t number) { }
+        
+        //! A number with a fraction or exponent, or an integer that doesn't fit 64 bits at all
+        /*! This is a long double if JSON_LONG_DOUBLE_REALS is defined, see json::Real */
+        virtual void real(Real number) { }
+        
+        //! A boolean value
+        virtual void boolean(bool boolean) { }
+        
+        //! A null value
+        virtual void null() { }
+    };
+}
+
+#endif
@@ -9,8 +9,17 @@
 #ifndef JSON_JSON_HPP
 #define JSON_JSON_HPP
 
+#include "arena.hpp"
+#include "cursor.hpp"
+#include "document.hpp"
 #include "error.hpp"
+#include "handler.hpp"
+#include "line_reader.hpp"
+#include "ordered_map.hpp"
+#include "parallel.hpp"
 #include "parse.hpp"
+#include "push_parser.hpp"
+#include "simd.hpp"
 #include "value.hpp"
 #include "writer.hpp"
 
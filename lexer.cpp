@@ -5,156 +5,470 @@
 //  Created by Stijn Frishert on 12/20/18.
 //
 
+#include <algorithm>
 #include <array>
 #include <cassert>
-#include <codecvt>
+#include <charconv>
 #include <cstdint>
+#include <cstring>
+#include <limits>
 #include <locale>
-#include <vector>
+#include <sstream>
 
 #include "lexer.hpp"
+#include "simd.hpp"
 
 namespace json
 {
+    //! The number of bytes we try to read from a stream at once
+    static constexpr std::size_t streamChunkSize = 64 * 1024;
+    
+    //! The bytes that skipContainer() has to look at: brackets, quotes and the start of comments
+    static constexpr auto containerSpecials = []
+    {
+        std::array<bool, 256> table{};
+        for (const unsigned char c : {'{', '}', '[', ']', '"', '/', '#'})
+            table[c] = true;
+        
+        return table;
+    }();
+    
+    Lexer::Lexer(std::string_view text) :
+        cursor(text.data()),
+        end(text.data() + text.size()),
+        base(text.data())
+    {
+        
+    }
+    
     Lexer::Lexer(std::istream& stream) :
-        stream(stream)
+        stream(&stream)
+    {
+        
+    }
+    
+    Lexer::Lexer() :
+        feeding(true)
+    {
+        
+    }
+    
+    Lexer::~Lexer()
+    {
+        if (!stream || cursor == end)
+            return;
+        
+        // Hand the bytes we read ahead back to the stream, so that whoever reads it
+        // next continues right after the value we lexed. This only fails if the bytes
+        // were read before the stream's last underflow, in which case they are lost.
+        auto* streamBuffer = stream->rdbuf();
+        for (auto it = end; it != cursor; --it)
+        {
+            if (streamBuffer->sputbackc(*(it - 1)) == std::char_traits<char>::eof())
+                break;
+        }
+        
+        stream->clear(stream->rdstate() & ~std::ios_base::eofbit);
+    }
+    
+    void Lexer::reset(std::string_view text)
     {
+        assert(!stream && !feeding);
         
+        cursor = text.data();
+        end = text.data() + text.size();
+        tokenStart = nullptr;
+        pending = Pending::NONE;
+        
+        base = text.data();
+        baseOffset = 0;
+        newlinesIndexed = 0;
+        newlinesIndexedUntil = 0;
+        lineStart = 0;
     }
     
     Token Lexer::getNextToken()
     {
+        if (!feeding && pending == Pending::NONE)
+            return lexToken();
+        
+        // The input may run out halfway a token, or the whitespace and comments before it. Whatever can
+        // be continued later is put aside with suspend(), anything else is lexed again from its start.
+        starved = false;
+        
+        const auto token = pending == Pending::NONE ? lexToken() : resumePending();
+        if (!starved)
+            return token;
+        
+        if (pending == Pending::NONE)
+            cursor = tokenStart;
+        
+        return createToken(Token::Type::INCOMPLETE);
+    }
+    
+    void Lexer::feed(const char* data, std::size_t size)
+    {
+        assert(!stream);
+        
+        // Keep what hasn't been consumed yet, including the start of a token that is still pending
+        const auto keeping = pending == Pending::STRING || pending == Pending::RUN;
+        const auto keepOffset = getOffset(keeping ? tokenStart : cursor);
+        const auto cursorOffset = getOffset(cursor);
+        
+        // Only drop the consumed bytes once they make up half of the buffer, so that every byte is moved
+        // a bounded number of times, however small the chunks. Count their newlines while we still can.
+        if (const auto consumed = keepOffset - baseOffset; consumed > 0 && consumed >= buffer.size() / 2)
+        {
+            indexNewlines(keepOffset);
+            buffer.erase(0, consumed);
+            baseOffset = keepOffset;
+        }
+        
+        buffer.append(data, size);
+        
+        base = buffer.data();
+        cursor = base + (cursorOffset - baseOffset);
+        end = base + buffer.size();
+        tokenStart = keeping ? base + (keepOffset - baseOffset) : nullptr;
+    }
+    
+    void Lexer::finish()
+    {
+        feeding = false;
+    }
+    
+    Token Lexer::lexToken()
+    {
+        tokenStart = nullptr;
         consumeWhitespaceAndComments();
         
-        if (stream.eof())
-            return createToken(Token::Type::END_OF_FILE, "");
-        else if (!stream.good())
-            return createToken(Token::Type::UNKNOWN, "");
+        const auto isAtEnd = atEnd();
         
-        const auto c = peek();
-        if (stream.eof())
-            return createToken(Token::Type::END_OF_FILE, "");
+        tokenStart = cursor;
         
+        if (isAtEnd)
+            return createToken(Token::Type::END_OF_FILE);
+        
+        const auto c = *cursor;
         switch (c)
         {
-            case '{': return createToken(Token::Type::LEFT_ACCOLADE, get());
-            case '}': return createToken(Token::Type::RIGHT_ACCOLADE, get());
-            case '[': return createToken(Token::Type::LEFT_SQUARE_BRACKET, get());
-            case ']': return createToken(Token::Type::RIGHT_SQUARE_BRACKET, get());
-            case ':': return createToken(Token::Type::COLON, get());
-            case ',': return createToken(Token::Type::COMMA, get());
+            case '{': ignore(); return createToken(Token::Type::LEFT_ACCOLADE);
+            case '}': ignore(); return createToken(Token::Type::RIGHT_ACCOLADE);
+            case '[': ignore(); return createToken(Token::Type::LEFT_SQUARE_BRACKET);
+            case ']': ignore(); return createToken(Token::Type::RIGHT_SQUARE_BRACKET);
+            case ':': ignore(); return createToken(Token::Type::COLON);
+            case ',': ignore(); return createToken(Token::Type::COMMA);
             case '\"': return consumeString();
-            case '-': return consumeNumber();
             default: break;
         }
         
-        if (::isdigit(c))
+        if (feeding && !awaitRun())
+            return createToken(Token::Type::INCOMPLETE);
+        
+        if (c == '-' || ::isdigit(static_cast<unsigned char>(c)))
             return consumeNumber();
         else
             return consumeIdentifier();
     }
     
-    void Lexer::consumeWhitespaceAndComments()
+    Token Lexer::resumePending()
     {
-        consumeWhitespace();
-        
-        if (!acceptComments)
-            return;
+        const auto kind = pending;
+        pending = Pending::NONE;
         
-        switch (peek())
+        switch (kind)
         {
-            case '#':
+            case Pending::STRING:
+                return continueString(pendingEscaped);
+            
+            case Pending::RUN:
+                if (!awaitRun())
+                    return createToken(Token::Type::INCOMPLETE);
+                
+                // All of it is there now, so lex it from the start
+                cursor = tokenStart;
+                if (*cursor == '-' || ::isdigit(static_cast<unsigned char>(*cursor)))
+                    return consumeNumber();
+                else
+                    return consumeIdentifier();
+            
+            case Pending::LINE_COMMENT:
                 ignoreLine();
-                return consumeWhitespaceAndComments();
-            case '/':
-                switch (peek(1))
-                {
-                    case '/':
+                break;
+            
+            case Pending::BLOCK_COMMENT:
+                continueBlockComment();
+                break;
+            
+            case Pending::NONE:
+                break;
+        }
+        
+        // The comment may have run out again, or else the next token follows it
+        if (starved)
+            return createToken(Token::Type::INCOMPLETE);
+        
+        return lexToken();
+    }
+    
+    bool Lexer::awaitRun()
+    {
+        // These are all the bytes that numbers and identifiers consist of, and what either looks ahead at
+        // lies within them or right after them
+        auto* it = cursor;
+        while (it != end && (::isalnum(static_cast<unsigned char>(*it)) || *it == '.' || *it == '+' || *it == '-'))
+            ++it;
+        
+        if (it != end || !feeding)
+            return true;
+        
+        starved = true;
+        suspend(Pending::RUN, it);
+        return false;
+    }
+    
+    void Lexer::suspend(Pending kind, const char* resume)
+    {
+        pending = kind;
+        cursor = resume;
+        
+        // Comments aren't tokens, so there's nothing to keep before where they continue
+        if (kind == Pending::LINE_COMMENT || kind == Pending::BLOCK_COMMENT)
+            tokenStart = resume;
+    }
+    
+    Token Lexer::skipContainer()
+    {
+        tokenStart = nullptr;
+        
+        std::size_t depth = 1;
+        while (!atEnd())
+        {
+            // Skip everything that can't open or close a bracket in one go
+            while (cursor != end && !containerSpecials[static_cast<unsigned char>(*cursor)])
+                ++cursor;
+            
+            if (cursor == end)
+                continue;
+            
+            switch (*cursor)
+            {
+                case '{':
+                case '[':
+                    ++depth;
+                    ++cursor;
+                    break;
+                case '}':
+                case ']':
+                    if (--depth == 0)
+                    {
+                        tokenStart = cursor;
+                        const auto type = *cursor == '}' ? Token::Type::RIGHT_ACCOLADE : Token::Type::RIGHT_SQUARE_BRACKET;
+                        ignore();
+                        return createToken(type);
+                    }
+                    
+                    ++cursor;
+                    break;
+                case '\"':
+                    ++cursor;
+                    if (!skipString())
+                        return createToken(Token::Type::END_OF_FILE);
+                    
+                    break;
+                default:
+                    // The start of a comment, or just a slash or hash where it doesn't belong
+                    if (acceptComments && (*cursor == '#' || peek(1) == '/'))
                         ignoreLine();
-                        consumeWhitespaceAndComments();
-                        return;
-                    case '*':
+                    else if (acceptComments && peek(1) == '*')
                         ignoreBlockComment();
-                        consumeWhitespaceAndComments();
-                        return;
-                }
+                    else
+                        ++cursor;
+                    
+                    break;
+            }
         }
+        
+        tokenStart = cursor;
+        return createToken(Token::Type::END_OF_FILE);
     }
     
-    void Lexer::consumeWhitespace()
+    void Lexer::consumeWhitespaceAndComments()
     {
         while (true)
         {
-            if (const auto p = peek(); stream.eof() || !::isspace(p))
-                break;
+            consumeWhitespace();
             
-            ignore();
+            if (!acceptComments || atEnd())
+                return;
+            
+            if (*cursor == '#')
+                ignoreLine();
+            else if (*cursor == '/' && peek(1) == '/')
+                ignoreLine();
+            else if (*cursor == '/' && peek(1) == '*')
+                ignoreBlockComment();
+            else
+                return;
         }
     }
     
+    void Lexer::consumeWhitespace()
+    {
+        // Most tokens are followed by no or a single whitespace, so check before scanning
+        while (!atEnd() && isWhitespace(*cursor))
+            cursor = skipWhitespace(cursor, end);
+    }
+    
     Token Lexer::consumeNumber()
     {
-        assert(stream.good());
+        assert(!atEnd());
+        
+        const auto negative = peek() == '-';
+        if (negative)
+            ignore();
         
-        std::string lexeme;
-        if (peek() == '-')
-            lexeme += get();
+        // Accumulate the digits into a significand while lexing. Up to 19 digits always fit,
+        // more than that may overflow, in which case we stop accumulating and remember that
+        // the significand was truncated.
+        std::uint64_t significand = 0;
+        auto truncated = false;
         
-        lexeme += consumeDigitString();
+        const auto integerDigits = consumeDigits(significand, truncated);
+        if (integerDigits == 0)
+            return createError(ErrorCode::INVALID_NUMBER);
         
-        if (const auto p = peek(); stream.good() && p == '.')
+        const auto integerIsZero = significand == 0;
+        
+        std::int64_t exponent = 0;
+        auto isReal = false;
+        
+        if (peek() == '.')
         {
-            lexeme += get();
-            lexeme += consumeDigitString();
+            ignore();
+            isReal = true;
+            
+            const auto fractionDigits = consumeDigits(significand, truncated);
+            if (fractionDigits == 0)
+                return createError(ErrorCode::INVALID_NUMBER);
+            
+            exponent -= static_cast<std::int64_t>(fractionDigits);
         }
         
-        if (const auto p = peek(); stream.good() && (p == 'e' || p == 'E'))
+        std::int64_t explicitExponent = 0;
+        if (const auto p = peek(); p == 'e' || p == 'E')
         {
-            lexeme += get();
+            ignore();
+            isReal = true;
+            
+            auto negativeExponent = false;
+            if (const auto p = peek(); p == '+' || p == '-')
+            {
+                negativeExponent = p == '-';
+                ignore();
+            }
+            
+            // Exponents this large are out of range for a real anyway, so clamp
+            auto exponentDigits = 0;
+            while (!atEnd() && ::isdigit(static_cast<unsigned char>(*cursor)))
+            {
+                explicitExponent = std::min<std::int64_t>(explicitExponent * 10 + (*cursor - '0'), 1'000'000);
+                ++exponentDigits;
+                ++cursor;
+            }
             
-            if (const auto p = peek(); stream.good() && (p == '+' || p == '-'))
-                lexeme += get();
+            if (exponentDigits == 0)
+                return createError(ErrorCode::INVALID_NUMBER);
             
-            lexeme += consumeDigitString();
+            if (negativeExponent)
+                explicitExponent = -explicitExponent;
+            
+            exponent += explicitExponent;
         }
         
-        return createToken(Token::Type::NUMBER, lexeme);
+        auto token = createToken(Token::Type::NUMBER);
+        
+        if (!isReal && !truncated)
+        {
+            if (!negative && significand <= static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max()))
+            {
+                token.numberType = Token::NumberType::SIGNED;
+                token.signedInteger = static_cast<std::int64_t>(significand);
+                return token;
+            } else if (!negative) {
+                token.numberType = Token::NumberType::UNSIGNED;
+                token.unsignedInteger = significand;
+                return token;
+            } else if (significand <= static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max()) + 1) {
+                // Negate in unsigned arithmetic, so that INT64_MIN doesn't overflow
+                token.numberType = Token::NumberType::SIGNED;
+                token.signedInteger = static_cast<std::int64_t>(0 - significand);
+                return token;
+            }
+        }
+        
+        // Integers out of the 64-bit range become reals as well
+        token.numberType = Token::NumberType::REAL;
+        
+        // If the significand and power of ten are both exactly representable as a double (and
+        // therefore as a long double too), one multiplication or division gives a correctly rounded
+        // result (Clinger's fast path)
+        static constexpr double powersOfTen[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+        
+        if (!truncated && significand <= (std::uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+        {
+            auto real = static_cast<Real>(significand);
+            real = exponent < 0 ? real / static_cast<Real>(powersOfTen[-exponent]) : real * static_cast<Real>(powersOfTen[exponent]);
+            token.real = negative ? -real : real;
+            return token;
+        }
+        
+        token.real = parseReal(token.lexeme, (integerIsZero ? 0 : static_cast<std::int64_t>(integerDigits)) + explicitExponent > 0);
+        return token;
     }
     
-    std::string Lexer::consumeDigitString()
+    std::size_t Lexer::consumeDigits(std::uint64_t& significand, bool& truncated)
     {
-        std::string string;
+        static constexpr auto maximum = std::numeric_limits<std::uint64_t>::max();
         
-        while (true)
+        std::size_t count = 0;
+        while (!atEnd())
         {
-            if (const auto p = peek(); !stream.good() || !::isdigit(p))
+            const auto digit = static_cast<unsigned int>(static_cast<unsigned char>(*cursor)) - '0';
+            if (digit > 9)
                 break;
             
-            string += get();
+            if (!truncated && significand <= (maximum - digit) / 10)
+                significand = significand * 10 + digit;
+            else
+                truncated = true;
+            
+            ++count;
+            ++cursor;
         }
         
-        return string;
+        return count;
     }
     
     Token Lexer::consumeIdentifier()
     {
-        std::string lexeme;
-        while (true)
+        while (!atEnd() && ::isalpha(static_cast<unsigned char>(*cursor)))
         {
-            if (const auto p = peek(); !stream.good() || !::isalpha(p))
-                break;
+            ignore();
             
-            lexeme += get();
-        
+            const std::string_view lexeme(tokenStart, static_cast<std::size_t>(cursor - tokenStart));
             if (lexeme == "true")
-                return createToken(Token::Type::BOOL_TRUE, lexeme);
+                return createToken(Token::Type::BOOL_TRUE);
             else if (lexeme == "false")
-                return createToken(Token::Type::BOOL_FALSE, lexeme);
+                return createToken(Token::Type::BOOL_FALSE);
             else if (lexeme == "null")
-                return createToken(Token::Type::NIL, lexeme);
+                return createToken(Token::Type::NIL);
         }
         
-        return createToken(Token::Type::UNKNOWN, lexeme);
+        return createToken(Token::Type::UNKNOWN);
     }
     
     Token Lexer::consumeString()
@@ -162,160 +476,462 @@ namespace json
         assert(peek() == '"');
         ignore();
         
-        std::string lexeme;
-        while (true)
+        return continueString(false);
+    }
+    
+    Token Lexer::continueString(bool escaped)
+    {
+        // When fed input runs out, the string is put aside, to continue from a point up until which
+        // scratch holds a number of unescaped bytes
+        const auto suspendString = [&](const char* resume, std::size_t unescaped)
         {
-            const auto p = peek();
-            if (!stream.good())
-                break;
+            scratch.resize(unescaped);
+            pendingEscaped = escaped;
+            suspend(Pending::STRING, resume);
+        };
+        
+        // As long as we don't encounter any escape sequences, the lexeme can view
+        // straight into the input. Only after the first one we copy into scratch.
+        while (!atEnd())
+        {
+            // Skip (or copy) the run of plain content up until the next special character at once
+            const auto* special = findStringSpecial(cursor, end);
+            if (escaped)
+                scratch.append(cursor, special);
+            
+            cursor = special;
             
+            if (cursor == end)
+                continue;
+            
+            const auto p = *cursor;
             if (p == '\"')
             {
+                const auto size = static_cast<std::size_t>(cursor - tokenStart - 1);
+                
+                // Escape sequences are ASCII, and \\u escapes always decode to valid UTF-8, so
+                // checking the raw content covers the unescaped string as well
+                if (validateUtf8 && !json::validateUtf8(tokenStart + 1, cursor))
+                    return createError(ErrorCode::INVALID_UTF8);
+                
                 ignore();
-                break;
+                
+                return createToken(Token::Type::STRING, escaped ? std::string_view(scratch) : std::string_view(tokenStart + 1, size));
             }
             else if (p == '\\')
             {
+                if (!escaped)
+                {
+                    scratch.assign(tokenStart + 1, cursor);
+                    escaped = true;
+                }
+                
+                // Fed input that runs out halfway the escape sequence has it lexed again from the backslash
+                const auto* sequence = cursor;
+                const auto unescaped = scratch.size();
+                
                 ignore();
                 
-                const auto c = get();
-                if (!stream.good())
+                if (atEnd())
+                {
+                    if (starved)
+                        suspendString(sequence, unescaped);
+                    
                     break;
+                }
                 
+                const auto c = get();
                 switch (c)
                 {
-                    case '\"': lexeme += '\"'; break;
-                    case '\\': lexeme += '\\'; break;
-                    case '/': lexeme += '/'; break;
-                    case 'b': lexeme += '\b'; break;
-                    case 'f': lexeme += '\f'; break;
-                    case 'n': lexeme += '\n'; break;
-                    case 'r': lexeme += '\r'; break;
-                    case 't': lexeme += '\t'; break;
-                    case 'u': lexeme += consumeUtf32CodePoint(); break;
+                    case '\"': scratch += '\"'; break;
+                    case '\\': scratch += '\\'; break;
+                    case '/': scratch += '/'; break;
+                    case 'b': scratch += '\b'; break;
+                    case 'f': scratch += '\f'; break;
+                    case 'n': scratch += '\n'; break;
+                    case 'r': scratch += '\r'; break;
+                    case 't': scratch += '\t'; break;
+                    case 'u':
+                        if (consumeUnicodeEscape())
+                            break;
+                        
+                        if (starved)
+                        {
+                            suspendString(sequence, unescaped);
+                            return createToken(Token::Type::INCOMPLETE);
+                        }
+                        
+                        return createError(ErrorCode::INVALID_UNICODE_ESCAPE);
                     default:
-                        lexeme += '\\';
-                        lexeme += c;
+                        scratch += '\\';
+                        scratch += c;
                         break;
                 }
                 
                 continue;
             }
             
-            lexeme += get();
+            // Control characters aren't allowed in strings, but let them through anyway
+            if (escaped)
+                scratch += p;
+            
+            ignore();
         }
         
-        return createToken(Token::Type::STRING, lexeme);
-    }
-    
-    std::string Lexer::consumeUtf32CodePoint()
-    {
-        std::uint32_t codePoint = 0;
-        stream >> std::hex >> codePoint;
+        if (starved && pending == Pending::NONE)
+            suspendString(cursor, scratch.size());
         
-#ifndef WIN32
-        static std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> converter;
-#else
-        static std::wstring_convert<std::codecvt_utf8<std::uint32_t>, std::uint32_t> converter;
-#endif
-        
-        return converter.to_bytes(codePoint);
+        return createError(ErrorCode::UNTERMINATED_STRING);
     }
     
-    char Lexer::peek()
+    bool Lexer::skipString()
     {
-        if (!rollBackStack.empty())
-            return rollBackStack.top();
-        else
-            return static_cast<char>(stream.peek());
+        while (!atEnd())
+        {
+            cursor = findStringSpecial(cursor, end);
+            if (cursor == end)
+                continue;
+            
+            // Control characters are let through, just like in consumeString()
+            const auto c = *cursor++;
+            if (c == '\"')
+                return true;
+            
+            if (c == '\\')
+                ignore();
+        }
+        
+        return false;
     }
     
-    char Lexer::peek(std::size_t offset)
+    Real Lexer::parseReal(std::string_view lexeme, bool large)
     {
-        std::vector<char> history(offset, 0);
-        for (auto& c : history)
-            c = getWithoutPositionChange();
-        
-        auto p = peek();
+        auto real = Real{0};
+
+#if defined(__cpp_lib_to_chars)
+        const auto result = std::from_chars(lexeme.data(), lexeme.data() + lexeme.size(), real);
+        if (result.ec == std::errc::result_out_of_range)
+        {
+            // from_chars() leaves the value alone in this case, so saturate ourselves
+            real = large ? std::numeric_limits<Real>::infinity() : Real{0};
+            return lexeme.front() == '-' ? -real : real;
+        }
+#else
+        // Don't use strtod(), which depends on the locale's decimal point
+        std::istringstream stream{std::string(lexeme)};
+        stream.imbue(std::locale::classic());
+        stream >> real;
         
-        for (auto it = history.rbegin(); it != history.rend(); it++)
-            rollBack(*it);
+        if (stream.fail())
+        {
+            real = large ? std::numeric_limits<Real>::infinity() : Real{0};
+            return lexeme.front() == '-' ? -real : real;
+        }
+#endif
         
-        return p;
+        return real;
     }
     
-    char Lexer::get()
+    bool Lexer::consumeUnicodeEscape()
     {
-        const auto c = getWithoutPositionChange();
+        auto codePoint = std::uint32_t{0};
+        if (!consumeUtf16CodeUnit(codePoint))
+            return false;
+        
+        // Code points outside the basic multilingual plane are escaped as a surrogate pair
+        if (codePoint >= 0xD800 && codePoint <= 0xDBFF)
+        {
+            if (peek() != '\\' || peek(1) != 'u')
+                return false;
+            
+            cursor += 2;
+            
+            auto low = std::uint32_t{0};
+            if (!consumeUtf16CodeUnit(low) || low < 0xDC00 || low > 0xDFFF)
+                return false;
+            
+            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+        } else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF) {
+            return false;
+        }
         
-        if (c == '\n')
+        // Encode as UTF-8
+        char bytes[4];
+        std::size_t size = 0;
+        if (codePoint < 0x80)
         {
-            line += 1;
-            character = 0;
+            bytes[size++] = static_cast<char>(codePoint);
+        } else if (codePoint < 0x800) {
+            bytes[size++] = static_cast<char>(0xC0 | (codePoint >> 6));
+            bytes[size++] = static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else if (codePoint < 0x10000) {
+            bytes[size++] = static_cast<char>(0xE0 | (codePoint >> 12));
+            bytes[size++] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            bytes[size++] = static_cast<char>(0x80 | (codePoint & 0x3F));
         } else {
-            character += 1;
+            bytes[size++] = static_cast<char>(0xF0 | (codePoint >> 18));
+            bytes[size++] = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            bytes[size++] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            bytes[size++] = static_cast<char>(0x80 | (codePoint & 0x3F));
         }
         
-        return c;
+        scratch.append(bytes, size);
+        return true;
     }
     
-    char Lexer::getWithoutPositionChange()
+    bool Lexer::consumeUtf16CodeUnit(std::uint32_t& codeUnit)
     {
-        if (rollBackStack.empty())
+        //! The value of each hexadecimal digit, or -1 for other bytes
+        static constexpr auto hexValues = []
         {
-            return static_cast<char>(stream.get());
-        }
-        else
+            std::array<std::int8_t, 256> table = {};
+            for (auto& value : table)
+                value = -1;
+            
+            for (auto c = '0'; c <= '9'; ++c)
+                table[static_cast<unsigned char>(c)] = static_cast<std::int8_t>(c - '0');
+            
+            for (auto c = 'a'; c <= 'f'; ++c)
+            {
+                table[static_cast<unsigned char>(c)] = static_cast<std::int8_t>(c - 'a' + 10);
+                table[static_cast<unsigned char>(c - 'a' + 'A')] = static_cast<std::int8_t>(c - 'a' + 10);
+            }
+            
+            return table;
+        }();
+        
+        // Exactly four digits, no more and no less
+        if (static_cast<std::size_t>(end - cursor) < 4 && !refill(4))
+            return false;
+        
+        codeUnit = 0;
+        for (auto i = 0; i < 4; ++i)
         {
-            const auto c = rollBackStack.top();
-            rollBackStack.pop();
-            return c;
+            const auto value = hexValues[static_cast<unsigned char>(cursor[i])];
+            if (value < 0)
+                return false;
+            
+            codeUnit = (codeUnit << 4) | static_cast<std::uint32_t>(value);
         }
+        
+        cursor += 4;
+        return true;
+    }
+    
+    bool Lexer::atEnd()
+    {
+        return cursor == end && !refill(1);
+    }
+    
+    char Lexer::peek()
+    {
+        return atEnd() ? '\0' : *cursor;
+    }
+    
+    char Lexer::peek(std::size_t offset)
+    {
+        // Contiguous input is indexed directly. Streams guarantee the lookahead by refilling
+        // (which moves the unconsumed bytes to the front of the buffer), so neither allocates.
+        if (static_cast<std::size_t>(end - cursor) <= offset && !refill(offset + 1))
+            return '\0';
+        
+        return cursor[offset];
+    }
+    
+    char Lexer::get()
+    {
+        if (atEnd())
+            return '\0';
+        
+        return *cursor++;
     }
     
     void Lexer::ignore()
     {
-        // Call get, because we don't actually want to ignore but
-        // increment the line or character in case of certain values
-        [[maybe_unused]] const auto c = get();
+        if (!atEnd())
+            ++cursor;
     }
     
     void Lexer::ignoreLine()
     {
-        while (get() != '\n')
+        while (!atEnd())
         {
-            if (!stream.good())
+            const auto* newline = static_cast<const char*>(std::memchr(cursor, '\n', static_cast<std::size_t>(end - cursor)));
+            if (newline)
+            {
+                cursor = newline + 1;
                 return;
+            }
+            
+            // The line continues into the next chunk
+            cursor = end;
         }
+        
+        if (starved)
+            suspend(Pending::LINE_COMMENT, cursor);
     }
     
     void Lexer::ignoreBlockComment()
     {
-        while (true)
+        assert(peek() == '/' && peek(1) == '*');
+        ignore();
+        ignore();
+        
+        continueBlockComment();
+    }
+    
+    void Lexer::continueBlockComment()
+    {
+        while (!atEnd())
         {
-            if (get() == '*' && peek() == '/')
+            const auto* star = static_cast<const char*>(std::memchr(cursor, '*', static_cast<std::size_t>(end - cursor)));
+            if (!star)
+            {
+                cursor = end;
+                continue;
+            }
+            
+            // Peeking past the star refills if it was the last byte of a chunk
+            cursor = star + 1;
+            if (peek() == '/')
             {
                 ignore();
                 return;
             }
             
-            if (!stream.good())
-                return;
+            // Fed input that runs out right after the star has it looked at again
+            if (starved)
+            {
+                cursor = star;
+                break;
+            }
+        }
+        
+        if (starved)
+            suspend(Pending::BLOCK_COMMENT, cursor);
+    }
+    
+    bool Lexer::refill(std::size_t count)
+    {
+        if (!stream)
+        {
+            starved = feeding;
+            return false;
+        }
+        
+        // Keep the token we're in the middle of, plus everything that hasn't been consumed yet.
+        // Move it to the front of the buffer, unless it's already there (as happens when a
+        // single token spans multiple chunks).
+        const auto* keep = tokenStart ? tokenStart : cursor;
+        const auto kept = static_cast<std::size_t>(end - keep);
+        const auto cursorOffset = static_cast<std::size_t>(cursor - keep);
+        
+        // The bytes before that are discarded, so count their newlines while we still can
+        const auto keepOffset = getOffset(keep);
+        indexNewlines(keepOffset);
+        
+        if (kept > 0 && keep != buffer.data())
+            std::memmove(buffer.data(), keep, kept);
+        
+        buffer.resize(std::max(kept + streamChunkSize, cursorOffset + count));
+        std::size_t size = kept;
+        
+        auto* streamBuffer = stream->rdbuf();
+        while (streamBuffer && size < cursorOffset + count)
+        {
+            // Only take what the stream already has buffered, so that we can put back
+            // whatever we don't end up using (see the destructor)
+            auto available = streamBuffer->in_avail();
+            if (available <= 0)
+            {
+                if (streamBuffer->sgetc() == std::char_traits<char>::eof())
+                {
+                    stream->setstate(std::ios_base::eofbit);
+                    break;
+                }
+                
+                available = std::max<std::streamsize>(streamBuffer->in_avail(), 1);
+            }
+            
+            const auto wanted = std::min<std::streamsize>(available, static_cast<std::streamsize>(buffer.size() - size));
+            const auto read = streamBuffer->sgetn(buffer.data() + size, wanted);
+            if (read <= 0)
+                break;
+            
+            size += static_cast<std::size_t>(read);
         }
+        
+        if (tokenStart)
+            tokenStart = buffer.data();
+        
+        cursor = buffer.data() + cursorOffset;
+        end = buffer.data() + size;
+        base = buffer.data();
+        baseOffset = keepOffset;
+        
+        return size >= cursorOffset + count;
+    }
+    
+    Lexer::Position Lexer::getPosition(std::size_t offset)
+    {
+        // Positions are usually asked for in increasing order, in which case we only need to count
+        // the newlines since the previous call. Otherwise, start over if the text is still around.
+        if (offset < newlinesIndexedUntil && baseOffset == 0)
+        {
+            newlinesIndexedUntil = 0;
+            newlinesIndexed = 0;
+            lineStart = 0;
+        }
+        
+        indexNewlines(std::min(offset, getOffset(end)));
+        
+        Position position;
+        position.line = newlinesIndexed;
+        position.character = offset >= lineStart ? offset - lineStart : 0;
+        return position;
+    }
+    
+    std::size_t Lexer::getOffset(const char* pointer) const
+    {
+        return baseOffset + static_cast<std::size_t>(pointer - base);
+    }
+    
+    void Lexer::indexNewlines(std::size_t offset)
+    {
+        if (offset <= newlinesIndexedUntil)
+            return;
+        
+        // Bytes of a stream that were discarded before they were indexed can't be counted anymore
+        const auto from = std::max(newlinesIndexedUntil, baseOffset);
+        if (from < offset)
+        {
+            const auto* it = base + (from - baseOffset);
+            const auto* until = base + (offset - baseOffset);
+            
+            while ((it = static_cast<const char*>(std::memchr(it, '\n', static_cast<std::size_t>(until - it)))))
+            {
+                ++newlinesIndexed;
+                lineStart = getOffset(++it);
+            }
+        }
+        
+        newlinesIndexedUntil = offset;
     }
     
-    void Lexer::rollBack(char c)
+    Token Lexer::createToken(Token::Type type) const
     {
-        rollBackStack.push(c);
+        return createToken(type, std::string_view(tokenStart, static_cast<std::size_t>(cursor - tokenStart)));
     }
     
     Token Lexer::createToken(Token::Type type, std::string_view lexeme) const
     {
-        return {type, lexeme, line, character - lexeme.size()};
+        return {type, lexeme, getOffset(tokenStart)};
     }
     
-    Token Lexer::createToken(Token::Type type, char c) const
+    Token Lexer::createError(ErrorCode error) const
     {
-        return createToken(type, std::string(1, c));
+        auto token = createToken(Token::Type::UNKNOWN);
+        token.error = error;
+        return token;
     }
 }
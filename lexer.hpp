@@ -8,8 +8,9 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <istream>
-#include <stack>
+#include <string>
 #include <string_view>
 
 #include "token.hpp"
@@ -19,45 +20,194 @@ namespace json
     class Lexer
     {
     public:
+        //! A line and character in the input, both zero-based
+        struct Position
+        {
+            std::size_t line = 0;
+            std::size_t character = 0;
+        };
+        
+    public:
+        //! Lex directly from a contiguous block of text
+        /*! @warning The text should outlive the lexer */
+        Lexer(std::string_view text);
+        
+        //! Lex from a stream, which is read in buffered chunks
+        /*! Bytes that were read ahead, but not consumed, are put back into the stream on destruction */
         Lexer(std::istream& stream);
         
+        //! Lex input that is fed in chunks, with feed()
+        Lexer();
+        
+        Lexer(const Lexer&) = delete;
+        Lexer& operator=(const Lexer&) = delete;
+        
+        ~Lexer();
+        
+        //! Start lexing another block of text, for a lexer that lexes contiguous text
+        /*! The scratch space for strings is kept, so that lexing many small texts only allocates while it's growing
+            @warning The text should outlive the lexer */
+        void reset(std::string_view text);
+        
         [[nodiscard]] Token getNextToken();
         
+        //! Append the next chunk of input, for a lexer that is fed its input
+        /*! Until finish() is called, tokens that run into the end of the input so far (including a
+            number, which might have more digits) come back as Token::Type::INCOMPLETE. Lexing them continues
+            where it left off after the next chunk, which only keeps the bytes of the unfinished token around. */
+        void feed(const char* data, std::size_t size);
+        
+        //! Signal that no more input will be fed, so that the end of the input is just that
+        void finish();
+        
+        //! Skip the rest of an array or object, whose opening bracket has already been read
+        /*! Only brackets, strings and comments are looked at, so that this is much quicker than lexing
+            the contents. Malformed contents, and mismatched kinds of brackets, go unnoticed.
+            @return The closing bracket, or the end of the input if that comes first */
+        [[nodiscard]] Token skipContainer();
+        
+        //! Compute the line and character of a byte offset into the input, e.g. that of a token
+        /*! Lexing itself only tracks byte offsets, so that well-formed input doesn't pay for this.
+            For streams, only offsets in the part that is still buffered are exact, which includes
+            the last token. */
+        [[nodiscard]] Position getPosition(std::size_t offset);
+        
     public:
         //! Do we accept comments, even though they are not part of the specification?
         bool acceptComments = true;
         
+        //! Do we check that strings are valid UTF-8?
+        /*! Off by default, in which case their bytes are passed through as is */
+        bool validateUtf8 = false;
+        
     private:
+        //! What the lexer can be in the middle of when fed input runs out
+        enum class Pending
+        {
+            NONE,           //!< Nothing, or something short that is simply lexed again from its start
+            STRING,         //!< A string, lexed up until the cursor, with the unescaped content so far in scratch
+            RUN,            //!< A number or identifier, of which the bytes up until the cursor have been seen
+            LINE_COMMENT,   //!< A comment that ends at the next newline
+            BLOCK_COMMENT   //!< A comment that ends at the next */
+        };
+        
+        //! Lex the next token, from all the input we have so far
+        [[nodiscard]] Token lexToken();
+        
         void consumeWhitespaceAndComments();
         void consumeWhitespace();
         
         [[nodiscard]] Token consumeNumber();
-        [[nodiscard]] std::string consumeDigitString();
+        std::size_t consumeDigits(std::uint64_t& significand, bool& truncated);
         [[nodiscard]] Token consumeIdentifier();
         [[nodiscard]] Token consumeString();
-        [[nodiscard]] std::string consumeUtf32CodePoint();
+        
+        //! Continue lexing a string, after its opening quote and everything up until the cursor
+        /*! @param escaped Has the string been copied into scratch so far, because it has escape sequences? */
+        [[nodiscard]] Token continueString(bool escaped);
+        
+        //! Continue lexing the token or comment that fed input ran out in the middle of
+        [[nodiscard]] Token resumePending();
+        
+        //! For fed input, check that the number or identifier that starts at tokenStart ends before the input does
+        /*! Otherwise it's put aside until more input is fed, remembering how far we looked. A number or
+            identifier is only lexed once all of it is there, so that it's lexed just once.
+            @return false if it was put aside */
+        bool awaitRun();
+        
+        //! Put aside the token or comment that fed input ran out in the middle of, to continue with it after the next feed()
+        /*! @param resume Where to continue from */
+        void suspend(Pending kind, const char* resume);
+        
+        //! Skip a string, whose opening quote has already been consumed, without decoding it
+        /*! @return false if the input ends first */
+        [[nodiscard]] bool skipString();
+        
+        //! Decode the code point of a \\u escape sequence, and append it to scratch as UTF-8
+        /*! @return false if the escape sequence is malformed, or an unpaired surrogate */
+        [[nodiscard]] bool consumeUnicodeEscape();
+        [[nodiscard]] bool consumeUtf16CodeUnit(std::uint32_t& codeUnit);
+        
+        //! Convert a real number that couldn't take the fast path
+        /*! @param large Is the number too large, rather than too small, in case it is out of range? */
+        [[nodiscard]] static Real parseReal(std::string_view lexeme, bool large);
+        
+        [[nodiscard]] bool atEnd();
         
         [[nodiscard]] char peek();
+        
+        //! Look ahead a small number of bytes, without consuming anything
         [[nodiscard]] char peek(std::size_t offset);
         
         [[nodiscard]] char get();
-        [[nodiscard]] char getWithoutPositionChange();
         
         void ignore();
         void ignoreLine();
         void ignoreBlockComment();
         
-        void rollBack(char c);
+        //! Skip the rest of a block comment, whose opening has already been consumed
+        void continueBlockComment();
+        
+        //! Read the next chunk of the stream, so that at least `count` bytes are available
+        /*! @return false if the input is exhausted before that */
+        bool refill(std::size_t count);
         
+        //! Return the offset into the input of a byte in the window
+        [[nodiscard]] std::size_t getOffset(const char* pointer) const;
+        
+        //! Count the newlines up until an offset into the input
+        void indexNewlines(std::size_t offset);
+        
+        //! Create a token whose lexeme is everything consumed since the token started
+        [[nodiscard]] Token createToken(Token::Type type) const;
         [[nodiscard]] Token createToken(Token::Type type, std::string_view lexeme) const;
-        [[nodiscard]] Token createToken(Token::Type type, char c) const;
+        
+        //! Create an unknown token, carrying the reason why it couldn't be lexed
+        [[nodiscard]] Token createError(ErrorCode error) const;
         
     private:
-        std::istream& stream;
+        //! The next byte to be consumed
+        const char* cursor = nullptr;
+        
+        //! One past the last byte that is available without refilling
+        const char* end = nullptr;
+        
+        //! The stream we read from, or nullptr if we lex contiguous text
+        std::istream* stream = nullptr;
+        
+        //! Holds the chunks read from the stream
+        std::string buffer;
+        
+        //! Will more input be fed, i.e. is running out of input not the end of it?
+        bool feeding = false;
+        
+        //! Did the lexer run out of input while feeding?
+        bool starved = false;
+        
+        //! What fed input ran out in the middle of, which is continued from the cursor once more has been fed
+        /*! That way, a long token that arrives in many small chunks is still lexed in linear time */
+        Pending pending = Pending::NONE;
+        
+        //! Has the pending string been copied into scratch so far?
+        bool pendingEscaped = false;
+        
+        //! The first byte of the token being lexed, which refills should keep around
+        const char* tokenStart = nullptr;
+        
+        //! Holds the contents of strings that had to be unescaped
+        /*! Reused between tokens, so that it only allocates while it's growing */
+        std::string scratch;
+        
+        //! A byte in the window, and its offset into the input
+        /*! For streams, this is the first byte that hasn't been discarded */
+        const char* base = nullptr;
+        std::size_t baseOffset = 0;
         
-        std::size_t line = 0;
-        std::size_t character = 0;
+        //! The number of newlines before newlinesIndexedUntil
+        std::size_t newlinesIndexed = 0;
+        std::size_t newlinesIndexedUntil = 0;
         
-        std::stack<char> rollBackStack;
+        //! The offset of the first byte after the last indexed newline
+        std::size_t lineStart = 0;
     };
 }
@@ -0,0 +1,195 @@
+//
+//  line_reader.cpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "error.hpp"
+#include "line_reader.hpp"
+
+using namespace std;
+
+namespace json
+{
+    //! The number of bytes we try to read from the stream at once
+    static constexpr size_t chunkSize = 64 * 1024;
+    
+    LineReader::LineReader(istream& stream, const ParseOptions& options, Framing framing) :
+        stream(&stream),
+        delimiter(framing == Framing::LINES ? '\n' : '\x1E'),
+        lexer(string_view()),
+        parser(lexer),
+        builder(record, &arena)
+    {
+        lexer.acceptComments = options.acceptComments;
+        lexer.validateUtf8 = options.validateUtf8;
+        parser.acceptCommaAfterLastEntry = options.acceptCommaAfterLastEntry;
+        parser.maxDepth = options.maxDepth;
+    }
+    
+    LineReader::LineReader(string_view text, const ParseOptions& options, Framing framing) :
+        delimiter(framing == Framing::LINES ? '\n' : '\x1E'),
+        lexer(string_view()),
+        parser(lexer),
+        builder(record, &arena),
+        window(text)
+    {
+        lexer.acceptComments = options.acceptComments;
+        lexer.validateUtf8 = options.validateUtf8;
+        parser.acceptCommaAfterLastEntry = options.acceptCommaAfterLastEntry;
+        parser.maxDepth = options.maxDepth;
+    }
+    
+    bool LineReader::read(Value& value)
+    {
+        if (!nextRecord())
+            return false;
+        
+        auto result = parser.tryParse();
+        if (!result)
+            fail(result.error);
+        
+        if (const auto error = parser.expectEnd())
+            fail(error);
+        
+        value = std::move(result.value);
+        return true;
+    }
+    
+    bool LineReader::read(Handler& handler)
+    {
+        if (!nextRecord())
+            return false;
+        
+        if (const auto error = parser.tryParse(handler))
+            fail(error);
+        
+        if (const auto error = parser.expectEnd())
+            fail(error);
+        
+        return true;
+    }
+    
+    bool LineReader::read()
+    {
+        clearRecord();
+        if (!nextRecord())
+            return false;
+        
+        auto error = parser.tryParse(builder);
+        if (!error)
+            error = parser.expectEnd();
+        
+        if (error)
+        {
+            clearRecord();
+            fail(error);
+        }
+        
+        return true;
+    }
+    
+    size_t LineReader::getLine() const
+    {
+        return recordLine;
+    }
+    
+    bool LineReader::nextRecord()
+    {
+        string_view record;
+        auto searched = begin;
+        
+        while (true)
+        {
+            // Find the end of the record, or read on if it isn't in the buffer yet
+            const auto* found = searched < window.size() ? memchr(window.data() + searched, delimiter, window.size() - searched) : nullptr;
+            if (found)
+            {
+                const auto end = static_cast<size_t>(static_cast<const char*>(found) - window.data());
+                record = string_view(window.data() + begin, end - begin);
+            } else {
+                // Filling moves what hasn't been consumed to the front of the window
+                searched = window.size() - begin;
+                if (fill())
+                    continue;
+                
+                // The last record doesn't need to be delimited
+                if (begin == window.size())
+                    return false;
+                
+                record = string_view(window.data() + begin, window.size() - begin);
+            }
+            
+            recordOffset = offset;
+            recordLine = line;
+            recordCharacter = character;
+            
+            // Consume the record and its delimiter, keeping track of where the next one starts
+            const auto consumed = min(record.size() + 1, window.size() - begin);
+            begin += consumed;
+            offset += consumed;
+            
+            if (delimiter == '\n')
+            {
+                ++line;
+                character = 0;
+            } else if (const auto newline = record.rfind('\n'); newline != string_view::npos) {
+                line += static_cast<size_t>(count(record.begin(), record.end(), '\n'));
+                character = consumed - newline - 1;
+            } else {
+                character += consumed;
+            }
+            
+            if (record.find_first_not_of(" \t\r\n") != string_view::npos)
+                break;
+            
+            searched = begin;
+        }
+        
+        lexer.reset(record);
+        
+        return true;
+    }
+    
+    bool LineReader::fill()
+    {
+        if (!stream)
+            return false;
+        
+        // Discard what has been consumed, so that the buffer only grows for records larger than a chunk
+        buffer.erase(0, begin);
+        begin = 0;
+        
+        const auto size = buffer.size();
+        buffer.resize(size + chunkSize);
+        stream->read(buffer.data() + size, static_cast<streamsize>(chunkSize));
+        
+        const auto read = static_cast<size_t>(stream->gcount());
+        buffer.resize(size + read);
+        window = buffer;
+        return read > 0;
+    }
+    
+    void LineReader::fail(ParseError error) const
+    {
+        error.offset += recordOffset;
+        if (error.line == 0)
+            error.character += recordCharacter;
+        
+        error.line += recordLine;
+        throw Error(error);
+    }
+    
+    void LineReader::clearRecord()
+    {
+        // Unless it was changed, the record is in the arena entirely, so that this doesn't visit any of it
+        record = Value::null;
+        arena.release();
+    }
+}
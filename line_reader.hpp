@@ -0,0 +1,146 @@
+//
+//  line_reader.hpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#ifndef JSON_LINE_READER_HPP
+#define JSON_LINE_READER_HPP
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <string_view>
+
+#include "arena.hpp"
+#include "builder.hpp"
+#include "handler.hpp"
+#include "lexer.hpp"
+#include "parse.hpp"
+#include "parser.hpp"
+#include "value.hpp"
+
+namespace json
+{
+    //! Reads a stream of Json documents, one record at a time
+    /*! Made for logs and other streams of many small documents. The read buffer, the lexer's scratch space
+        and the parser's stack are all reused between records, so that reading a record costs no more than
+        parsing it. Records that are empty or only whitespace are skipped. When each record is done with
+        before reading the next, read() without arguments reuses the memory of the values as well.
+        
+        Every record is parsed on its own, so a malformed one throws json::Error (with the line and
+        character in the whole stream), after which the reader continues with the next record.
+        
+        @code
+        json::LineReader reader(stream);
+        json::Value record;
+        while (reader.read(record))
+            process(record);
+        @endcode */
+    class LineReader
+    {
+    public:
+        //! How records are delimited
+        enum class Framing
+        {
+            LINES,      //!< By newlines: newline-delimited Json (NDJSON) or Json Lines
+            SEQUENCE    //!< By a record separator (0x1E) at the start of each record, as in RFC 7464 Json text sequences
+        };
+        
+    public:
+        //! Read records from a stream
+        /*! The stream is read ahead in large chunks, so after the reader it is at the end
+            @warning The stream should outlive the reader */
+        LineReader(std::istream& stream, const ParseOptions& options = {}, Framing framing = Framing::LINES);
+        
+        //! Read records from a contiguous block of text, e.g. one that is memory-mapped
+        /*! @warning The text should outlive the reader */
+        LineReader(std::string_view text, const ParseOptions& options = {}, Framing framing = Framing::LINES);
+        
+        LineReader(const LineReader&) = delete;
+        LineReader& operator=(const LineReader&) = delete;
+        
+        //! Read the next record into a value
+        /*! @return false if there are no more records, in which case the value is untouched
+            @throw json::Error if the record is not exactly one Json value */
+        bool read(Value& value);
+        
+        //! Read the next record, reporting its contents to a handler
+        /*! @return false if there are no more records
+            @throw json::Error if the record is not exactly one Json value. The handler will have
+                   received the events up until the error. */
+        bool read(Handler& handler);
+        
+        //! Read the next record into a value that the reader holds, reusing the memory of the previous one
+        /*! The value is allocated from an arena that the reader owns, which is released at once before the
+            next record, like json::Document does. Once the reader has read a record of some size, reading
+            one that isn't larger doesn't allocate at all. The value is replaced by the next read, so copy
+            it to keep it around.
+            @return false if there are no more records, in which case the value is null
+            @throw json::Error if the record is not exactly one Json value, after which the value is null */
+        bool read();
+        
+        //! Return the record that read() without arguments read last
+        /*! It can be changed, but should not be moved out of the reader, as it's allocated from its arena */
+        Value& getRecord() { return record; }
+        const Value& getRecord() const { return record; }
+        
+        //! Return the zero-based line at which the last record that was read starts
+        std::size_t getLine() const;
+        
+    private:
+        //! Move to the next record that isn't blank, and set up the lexer to lex it
+        /*! @return false if there are no more records */
+        bool nextRecord();
+        
+        //! Read the next chunk of the stream, after what is in the buffer
+        /*! @return false if the stream is exhausted, or if we read from text */
+        bool fill();
+        
+        //! Throw a parsing error, moving its position from the record to the whole stream
+        [[noreturn]] void fail(ParseError error) const;
+        
+        //! Reset the record to null, and release what was allocated for it
+        void clearRecord();
+        
+    private:
+        //! The stream we read from, or nullptr if we read from text
+        std::istream* stream = nullptr;
+        
+        //! The byte that delimits records
+        char delimiter = '\n';
+        
+        Lexer lexer;
+        Parser parser;
+        
+        //! Where the record of read() without arguments is allocated, which should outlive it
+        Arena arena;
+        
+        //! The record that read() without arguments read last
+        Value record;
+        ValueBuilder builder;
+        
+        //! Holds what has been read from the stream, but not consumed yet
+        std::string buffer;
+        
+        //! The input we have at hand: the buffer, or all of the text
+        std::string_view window;
+        
+        //! The first byte in the window that hasn't been consumed, and its offset into the input
+        std::size_t begin = 0;
+        std::size_t offset = 0;
+        
+        //! The zero-based line and character of the first byte that hasn't been consumed
+        std::size_t line = 0;
+        std::size_t character = 0;
+        
+        //! The offset, line and character at which the last record starts
+        std::size_t recordOffset = 0;
+        std::size_t recordLine = 0;
+        std::size_t recordCharacter = 0;
+    };
+}
+
+#endif
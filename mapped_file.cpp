@@ -0,0 +1,112 @@
+//
+//  mapped_file.cpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#include <cerrno>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define JSON_HAS_MMAP 1
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+#include "mapped_file.hpp"
+
+namespace json
+{
+#if JSON_HAS_MMAP
+    //! The number of bytes we read at once from files that can't be mapped
+    static constexpr std::size_t readChunkSize = 64 * 1024;
+    
+    MappedFile::MappedFile(const std::string& path)
+    {
+        const auto descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (descriptor < 0)
+            throw std::system_error(errno, std::generic_category(), "Could not open " + path);
+        
+        struct stat status;
+        if (::fstat(descriptor, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0)
+        {
+            size = static_cast<std::size_t>(status.st_size);
+            auto* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (mapping != MAP_FAILED)
+            {
+                // The lexer reads front to back, so the kernel may read ahead aggressively, and drop pages behind us
+                ::madvise(mapping, size, MADV_SEQUENTIAL);
+                ::close(descriptor);
+                
+                data = static_cast<const char*>(mapping);
+                mapped = true;
+                return;
+            }
+        }
+        
+        // Pipes, devices and files that refused to be mapped are read until they end. Their size, if
+        // they report one at all, isn't to be trusted (as for files in /proc).
+        while (true)
+        {
+            const auto offset = buffer.size();
+            buffer.resize(offset + readChunkSize);
+            
+            const auto count = ::read(descriptor, buffer.data() + offset, readChunkSize);
+            if (count < 0 && errno == EINTR)
+            {
+                buffer.resize(offset);
+                continue;
+            }
+            
+            if (count < 0)
+            {
+                const auto error = errno;
+                ::close(descriptor);
+                throw std::system_error(error, std::generic_category(), "Could not read " + path);
+            }
+            
+            buffer.resize(offset + static_cast<std::size_t>(count));
+            if (count == 0)
+                break;
+        }
+        
+        ::close(descriptor);
+        data = buffer.data();
+        size = buffer.size();
+    }
+    
+    MappedFile::~MappedFile()
+    {
+        if (mapped)
+            ::munmap(const_cast<char*>(data), size);
+    }
+#else
+    MappedFile::MappedFile(const std::string& path)
+    {
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream)
+            throw std::system_error(errno, std::generic_category(), "Could not open " + path);
+        
+        buffer.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        if (stream.bad())
+            throw std::system_error(errno, std::generic_category(), "Could not read " + path);
+        
+        data = buffer.data();
+        size = buffer.size();
+    }
+    
+    MappedFile::~MappedFile() = default;
+#endif
+    
+    std::string_view MappedFile::getText() const
+    {
+        return std::string_view(data, size);
+    }
+}
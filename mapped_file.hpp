@@ -0,0 +1,47 @@
+//
+//  mapped_file.hpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace json
+{
+    //! The contents of a file, mapped into memory where possible
+    /*! Regular files are mapped read-only, so that their pages are read in by the kernel as they're needed,
+        without copying them. Files that can't be mapped, like pipes and character devices, are read into a
+        buffer instead. So are all files on platforms without mmap(). */
+    class MappedFile
+    {
+    public:
+        //! Map or read a file
+        /*! @throw std::system_error if the file can't be opened or read */
+        explicit MappedFile(const std::string& path);
+        
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        
+        ~MappedFile();
+        
+        //! Return the contents of the file
+        std::string_view getText() const;
+        
+    private:
+        //! The contents, be they mapped or in the buffer
+        const char* data = nullptr;
+        std::size_t size = 0;
+        
+        //! Is data a mapping, which should be unmapped?
+        bool mapped = false;
+        
+        //! Holds the contents of files that couldn't be mapped
+        std::string buffer;
+    };
+}
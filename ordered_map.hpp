@@ -0,0 +1,251 @@
+//
+//  ordered_map.hpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#ifndef JSON_ORDERED_MAP_HPP
+#define JSON_ORDERED_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "arena.hpp"
+
+namespace json
+{
+    //! An associative container with string keys, which keeps its entries in the order they were inserted
+    /*! The entries are stored next to each other in a vector. Small maps, which most Json objects are,
+        find keys by scanning that. Maps of more than indexThreshold entries also keep an open-addressing
+        hash index into the vector, so that looking up keys in them stays constant time.
+        
+        Inserting an entry invalidates iterators and references, like it does for a vector. So does
+        erasing one, which moves the entries after it.
+        
+        The entries, their keys and the index can be allocated from an arena. Copies allocate from the heap.
+        @warning Keys should not be changed through iterators, or they can't be found anymore */
+    template <class T>
+    class OrderedMap
+    {
+        friend T;
+        
+    public:
+        using key_type = std::basic_string<char, std::char_traits<char>, Allocator<char>>;
+        using mapped_type = T;
+        using value_type = std::pair<key_type, T>;
+        using allocator_type = Allocator<value_type>;
+        using size_type = std::size_t;
+        using iterator = typename std::vector<value_type, allocator_type>::iterator;
+        using const_iterator = typename std::vector<value_type, allocator_type>::const_iterator;
+        
+        //! The number of entries above which keys are looked up through a hash index
+        static constexpr std::size_t indexThreshold = 16;
+        
+    public:
+        OrderedMap() = default;
+        
+        //! Construct an empty map, which allocates from an arena
+        explicit OrderedMap(const allocator_type& allocator) :
+            entries(allocator),
+            slots(allocator)
+        {
+            
+        }
+        
+        //! Construct from a list of entries, ignoring those with a key that was listed before
+        OrderedMap(std::initializer_list<value_type> list)
+        {
+            reserve(list.size());
+            for (auto& entry : list)
+                try_emplace(entry.first, entry.second);
+        }
+        
+        iterator begin() noexcept { return entries.begin(); }
+        const_iterator begin() const noexcept { return entries.begin(); }
+        const_iterator cbegin() const noexcept { return entries.cbegin(); }
+        
+        iterator end() noexcept { return entries.end(); }
+        const_iterator end() const noexcept { return entries.end(); }
+        const_iterator cend() const noexcept { return entries.cend(); }
+        
+        //! Return the number of entries
+        size_type size() const noexcept { return entries.size(); }
+        
+        //! Are there no entries?
+        bool empty() const noexcept { return entries.empty(); }
+        
+        //! Remove all entries
+        void clear() noexcept
+        {
+            entries.clear();
+            slots.clear();
+        }
+        
+        //! Reserve room for a number of entries
+        void reserve(size_type capacity) { entries.reserve(capacity); }
+        
+        //! Return the allocator that the entries are allocated with
+        allocator_type get_allocator() const noexcept { return entries.get_allocator(); }
+        
+        //! Find the entry with a key
+        /*! @return end() if there is none */
+        iterator find(std::string_view key) { return begin() + static_cast<std::ptrdiff_t>(locate(key)); }
+        
+        //! Find the entry with a key
+        /*! @return end() if there is none */
+        const_iterator find(std::string_view key) const { return begin() + static_cast<std::ptrdiff_t>(locate(key)); }
+        
+        //! Return the number of entries with a key, which is either 0 or 1
+        size_type count(std::string_view key) const { return locate(key) < entries.size() ? 1 : 0; }
+        
+        //! Access the value of a key
+        /*! @throw std::out_of_range if there is no entry with the key */
+        T& at(std::string_view key)
+        {
+            const auto position = locate(key);
+            if (position == entries.size())
+                throw std::out_of_range("Json object, key '" + std::string(key) + "' not found");
+            
+            return entries[position].second;
+        }
+        
+        //! Access the value of a key
+        /*! @throw std::out_of_range if there is no entry with the key */
+        const T& at(std::string_view key) const
+        {
+            const auto position = locate(key);
+            if (position == entries.size())
+                throw std::out_of_range("Json object, key '" + std::string(key) + "' not found");
+            
+            return entries[position].second;
+        }
+        
+        //! Access the value of a key, appending a default-constructed one if there is no entry with it yet
+        T& operator[](std::string_view key) { return try_emplace(key).first->second; }
+        
+        //! Append an entry, constructing its value in place, unless there already is one with the key
+        /*! @return The entry with the key, and whether it was appended */
+        template <class... Args>
+        std::pair<iterator, bool> try_emplace(std::string_view key, Args&&... args)
+        {
+            const auto position = locate(key);
+            if (position < entries.size())
+                return {begin() + static_cast<std::ptrdiff_t>(position), false};
+            
+            return {append(key, std::forward<Args>(args)...), true};
+        }
+        
+        //! Append an entry, unless there already is one with its key
+        /*! @return The entry with the key, and whether it was appended */
+        std::pair<iterator, bool> insert(const value_type& entry) { return try_emplace(entry.first, entry.second); }
+        
+        //! Append an entry, unless there already is one with its key
+        /*! @return The entry with the key, and whether it was appended */
+        std::pair<iterator, bool> insert(value_type&& entry) { return try_emplace(entry.first, std::move(entry.second)); }
+        
+        //! Remove an entry, keeping the others in order
+        /*! @return The entry that followed it */
+        iterator erase(const_iterator position)
+        {
+            auto next = entries.erase(position);
+            if (!slots.empty())
+                reindex();
+            
+            return next;
+        }
+        
+        //! Remove the entry with a key, if there is one
+        /*! @return The number of entries removed, which is either 0 or 1 */
+        size_type erase(std::string_view key)
+        {
+            const auto position = locate(key);
+            if (position == entries.size())
+                return 0;
+            
+            erase(begin() + static_cast<std::ptrdiff_t>(position));
+            return 1;
+        }
+        
+    private:
+        //! Return the position of the entry with a key, or size() if there is none
+        std::size_t locate(std::string_view key) const
+        {
+            if (slots.empty())
+            {
+                for (std::size_t i = 0; i < entries.size(); ++i)
+                {
+                    if (entries[i].first == key)
+                        return i;
+                }
+                
+                return entries.size();
+            }
+            
+            const auto slot = slots[probe(key)];
+            return slot ? slot - 1 : entries.size();
+        }
+        
+        //! Append an entry with a key that isn't in the map yet
+        /*! The key is allocated like the entries are */
+        template <class... Args>
+        iterator append(std::string_view key, Args&&... args)
+        {
+            entries.emplace_back(std::piecewise_construct, std::forward_as_tuple(key, entries.get_allocator()), std::forward_as_tuple(std::forward<Args>(args)...));
+            
+            // The index is kept at most half full, so that probing stays short
+            if (!slots.empty() && entries.size() * 2 <= slots.size())
+                slots[probe(entries.back().first)] = static_cast<std::uint32_t>(entries.size());
+            else if (entries.size() > indexThreshold)
+                reindex();
+            
+            return end() - 1;
+        }
+        
+        //! Rebuild the index, or drop it if the map has become small enough to be scanned
+        void reindex()
+        {
+            slots.clear();
+            if (entries.size() <= indexThreshold)
+                return;
+            
+            std::size_t capacity = indexThreshold * 4;
+            while (capacity < entries.size() * 2)
+                capacity *= 2;
+            
+            slots.resize(capacity, 0);
+            for (std::size_t i = 0; i < entries.size(); ++i)
+                slots[probe(entries[i].first)] = static_cast<std::uint32_t>(i + 1);
+        }
+        
+        //! Return the slot of the index that refers to the entry with a key, or the empty slot where it would go
+        std::size_t probe(std::string_view key) const
+        {
+            const auto mask = slots.size() - 1;
+            for (auto slot = std::hash<std::string_view>()(key) & mask; ; slot = (slot + 1) & mask)
+            {
+                if (!slots[slot] || entries[slots[slot] - 1].first == key)
+                    return slot;
+            }
+        }
+        
+    private:
+        //! The entries, in the order they were inserted
+        std::vector<value_type, allocator_type> entries;
+        
+        //! The hash index, of which each slot holds either 0, or 1 plus the position of an entry
+        /*! This is empty for maps that are small enough to be scanned */
+        std::vector<std::uint32_t, Allocator<std::uint32_t>> slots;
+    };
+}
+
+#endif
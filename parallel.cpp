@@ -0,0 +1,245 @@
+//
+//  parallel.cpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "error.hpp"
+#include "line_reader.hpp"
+#include "parallel.hpp"
+#include "thread_pool.hpp"
+
+using namespace std;
+
+namespace json
+{
+    //! A range of lines that is parsed by one thread
+    struct LineChunk
+    {
+        //! Holds the text, when it was read from a stream
+        string storage;
+        
+        //! The lines in the chunk, all ending in a newline (apart from the last line of the input)
+        string_view text;
+        
+        //! The records parsed from the text, up until the first error
+        vector<Value> records;
+        
+        //! The first error in the text, with a line relative to the start of the chunk
+        ParseError error;
+        
+        //! Anything else that was thrown while parsing, such as std::bad_alloc, to be rethrown on the calling thread
+        exception_ptr exception;
+        
+        //! The number of newlines in the text
+        size_t lines = 0;
+        
+        //! Has the chunk been parsed? Guarded by the mutex of parseChunks().
+        bool parsed = false;
+        
+        //! Have its records been delivered?
+        bool delivered = false;
+    };
+    
+    //! Parse the records in a chunk
+    static void parseChunk(LineChunk& chunk, const ParseOptions& options)
+    {
+        LineReader reader(chunk.text, options);
+        
+        try
+        {
+            Value record;
+            while (reader.read(record))
+                chunk.records.push_back(std::move(record));
+        } catch (const Error& error) {
+            chunk.error.code = error.getCode();
+            chunk.error.line = error.getLine();
+            chunk.error.character = error.getCharacter();
+        } catch (...) {
+            chunk.exception = current_exception();
+        }
+        
+        chunk.lines = static_cast<size_t>(count(chunk.text.begin(), chunk.text.end(), '\n'));
+    }
+    
+    //! Parse the chunks that `next` fills on a thread pool, and deliver their records
+    template <class Next>
+    static void parseChunks(Next next, const RecordCallback& callback, const ParseOptions& options)
+    {
+        const auto& parallel = options.parallel;
+        
+        // Guards the `parsed` flags, and signals when one is raised
+        std::mutex mutex;
+        condition_variable parsed;
+        
+        // The chunks in flight in the order of the input, and finished ones to be reused
+        deque<unique_ptr<LineChunk>> chunks;
+        vector<unique_ptr<LineChunk>> spares;
+        
+        // The number of lines before the first chunk in flight
+        size_t lines = 0;
+        
+        // Declared last, so that its threads are stopped before anything they use goes away
+        ThreadPool pool(parallel.threadCount);
+        const auto maxChunksInFlight = parallel.maxChunksInFlight > 0 ? parallel.maxChunksInFlight : pool.getThreadCount() * 4;
+        
+        bool exhausted = false;
+        while (true)
+        {
+            // Keep the pool busy, up to the maximum number of chunks in flight
+            while (!exhausted && chunks.size() < maxChunksInFlight)
+            {
+                auto chunk = spares.empty() ? make_unique<LineChunk>() : std::move(spares.back());
+                if (!spares.empty())
+                    spares.pop_back();
+                
+                if (!next(*chunk))
+                {
+                    exhausted = true;
+                    break;
+                }
+                
+                auto& submitted = *chunk;
+                chunks.push_back(std::move(chunk));
+                
+                pool.submit([&submitted, &options, &mutex, &parsed]
+                {
+                    parseChunk(submitted, options);
+                    
+                    lock_guard<std::mutex> lock(mutex);
+                    submitted.parsed = true;
+                    parsed.notify_one();
+                });
+            }
+            
+            if (chunks.empty())
+                return;
+            
+            // Wait for a chunk that can be delivered. An error can only be thrown from the first chunk
+            // in flight, because only that knows the number of lines before it. The same goes for other
+            // exceptions, so that the records before them are delivered, as they would be sequentially.
+            LineChunk* ready = nullptr;
+            {
+                unique_lock<std::mutex> lock(mutex);
+                parsed.wait(lock, [&]
+                {
+                    const auto count = parallel.ordered ? 1 : chunks.size();
+                    for (size_t i = 0; i < count && !ready; ++i)
+                    {
+                        auto& chunk = *chunks[i];
+                        if (chunk.parsed && !chunk.delivered && (i == 0 || (!chunk.error && !chunk.exception)))
+                            ready = &chunk;
+                    }
+                    
+                    return ready != nullptr;
+                });
+            }
+            
+            for (auto& record : ready->records)
+                callback(std::move(record));
+            
+            if (ready->exception)
+                rethrow_exception(ready->exception);
+            
+            if (ready->error)
+            {
+                auto error = ready->error;
+                error.line += lines;
+                throw Error(error);
+            }
+            
+            ready->records.clear();
+            ready->delivered = true;
+            
+            // Retire the delivered chunks at the front, keeping their memory around for the next ones
+            while (!chunks.empty() && chunks.front()->delivered)
+            {
+                auto chunk = std::move(chunks.front());
+                chunks.pop_front();
+                
+                lines += chunk->lines;
+                chunk->error = {};
+                chunk->exception = nullptr;
+                chunk->parsed = false;
+                chunk->delivered = false;
+                spares.push_back(std::move(chunk));
+            }
+        }
+    }
+    
+    void parseLines(string_view text, const RecordCallback& callback, const ParseOptions& options)
+    {
+        const auto chunkSize = max<size_t>(options.parallel.chunkSize, 1);
+        size_t position = 0;
+        
+        parseChunks([&](LineChunk& chunk)
+        {
+            if (position == text.size())
+                return false;
+            
+            // Extend the chunk up to and including the newline that ends its last line
+            auto end = position + min(chunkSize, text.size() - position);
+            if (const auto* newline = static_cast<const char*>(memchr(text.data() + end - 1, '\n', text.size() - end + 1)))
+                end = static_cast<size_t>(newline - text.data()) + 1;
+            else
+                end = text.size();
+            
+            chunk.text = text.substr(position, end - position);
+            position = end;
+            return true;
+        }, callback, options);
+    }
+    
+    void parseLines(istream& stream, const RecordCallback& callback, const ParseOptions& options)
+    {
+        const auto chunkSize = max<size_t>(options.parallel.chunkSize, 1);
+        
+        // The start of a line that the previous chunk read, but didn't include
+        string partial;
+        
+        parseChunks([&](LineChunk& chunk)
+        {
+            auto& storage = chunk.storage;
+            storage = partial;
+            partial.clear();
+            
+            // Read until we have a complete line, cutting off what follows the last one
+            while (true)
+            {
+                const auto size = storage.size();
+                storage.resize(size + chunkSize);
+                stream.read(storage.data() + size, static_cast<streamsize>(chunkSize));
+                
+                const auto read = static_cast<size_t>(stream.gcount());
+                storage.resize(size + read);
+                if (read == 0)
+                    break;
+                
+                // Only look at what was just read, as there's no newline before it, so that a long line
+                // isn't searched again for every chunk of it
+                if (const auto newline = string_view(storage).substr(size).rfind('\n'); newline != string_view::npos)
+                {
+                    partial.assign(storage, size + newline + 1, string::npos);
+                    storage.resize(size + newline + 1);
+                    break;
+                }
+            }
+            
+            chunk.text = storage;
+            return !storage.empty();
+        }, callback, options);
+    }
+}
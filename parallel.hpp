@@ -0,0 +1,41 @@
+//
+//  parallel.hpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#ifndef JSON_PARALLEL_HPP
+#define JSON_PARALLEL_HPP
+
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <string_view>
+
+#include "parse.hpp"
+#include "value.hpp"
+
+namespace json
+{
+    //! Receives the records of newline-delimited Json, one at a time
+    using RecordCallback = std::function<void(Value&& record)>;
+    
+    //! Parse newline-delimited Json (NDJSON) text on multiple threads
+    /*! The text is split into chunks on line boundaries, which are parsed in parallel as set by
+        ParseOptions::parallel. The callback is called on the calling thread, one record at a time,
+        so it needs no synchronization of its own. Blank lines are skipped.
+        @throw json::Error for the first malformed record, after the records that precede it (in the input
+               when delivering in order, in time otherwise) have been delivered */
+    void parseLines(std::string_view text, const RecordCallback& callback, const ParseOptions& options = {});
+    
+    //! Parse newline-delimited Json (NDJSON) from stream on multiple threads
+    /*! The stream is read on the calling thread, a chunk at a time. Reading pauses while the maximum
+        number of chunks is in flight.
+        @throw json::Error for the first malformed record, after the records that precede it (in the input
+               when delivering in order, in time otherwise) have been delivered */
+    void parseLines(std::istream& stream, const RecordCallback& callback, const ParseOptions& options = {});
+}
+
+#endif
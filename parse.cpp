@@ -6,34 +6,300 @@
 //  Licensed under the BSD 3-clause license.
 //
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <codecvt>
+#include <condition_variable>
+#include <exception>
 #include <ios>
 #include <locale>
-#include <sstream>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "error.hpp"
 #include "parse.hpp"
 #include "parser.hpp"
 #include "lexer.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
 
 using namespace std;
 
 namespace json
 {
-	Value parse(std::istream& stream)
+    //! Unwrap the result of tryParse(), throwing if it failed
+    static Value unwrap(ParseResult&& result)
+    {
+        if (!result)
+            throw Error(result.error);
+        
+        return std::move(result.value);
+    }
+	
+	Value parse(std::istream& stream, const ParseOptions& options)
 	{
+        return unwrap(tryParse(stream, options));
+	}
+    
+    Value parse(std::string_view text, const ParseOptions& options)
+    {
+        return unwrap(tryParse(text, options));
+    }
+    
+    Value parse(const char* data, std::size_t size, const ParseOptions& options)
+    {
+        return unwrap(tryParse(data, size, options));
+    }
+    
+    Value parse(std::string_view text, Arena& arena, const ParseOptions& options)
+    {
+        return unwrap(tryParse(text, arena, options));
+    }
+    
+    //! Configure a lexer and parser according to the options
+    static void configure(Lexer& lexer, Parser& parser, const ParseOptions& options)
+    {
+        lexer.acceptComments = options.acceptComments;
+        lexer.validateUtf8 = options.validateUtf8;
+        parser.acceptCommaAfterLastEntry = options.acceptCommaAfterLastEntry;
+        parser.maxDepth = options.maxDepth;
+    }
+    
+    //! Find the elements of an array that makes up all of the text, without parsing them
+    /*! The elements that are arrays or objects themselves are skipped by matching brackets, which is
+        much quicker than parsing them. Each element includes the whitespace and comments after it.
+        @return false if the text isn't an array, or if something is off about its structure */
+    static bool findElements(std::string_view text, const ParseOptions& options, std::vector<std::string_view>& elements)
+    {
+        Lexer lexer(text);
+        lexer.acceptComments = options.acceptComments;
+        
+        if (lexer.getNextToken().type != Token::Type::LEFT_SQUARE_BRACKET)
+            return false;
+        
+        auto token = lexer.getNextToken();
+        if (token.type == Token::Type::RIGHT_SQUARE_BRACKET)
+            return true;
+        
+        while (true)
+        {
+            switch (token.type)
+            {
+                case Token::Type::LEFT_ACCOLADE:
+                case Token::Type::LEFT_SQUARE_BRACKET:
+                    if (lexer.skipContainer().type == Token::Type::END_OF_FILE)
+                        return false;
+                    
+                    break;
+                
+                case Token::Type::STRING:
+                case Token::Type::NUMBER:
+                case Token::Type::BOOL_TRUE:
+                case Token::Type::BOOL_FALSE:
+                case Token::Type::NIL:
+                    break;
+                
+                default:
+                    return false;
+            }
+            
+            const auto next = lexer.getNextToken();
+            elements.push_back(text.substr(token.offset, next.offset - token.offset));
+            
+            if (next.type == Token::Type::RIGHT_SQUARE_BRACKET)
+                return true;
+            
+            if (next.type != Token::Type::COMMA)
+                return false;
+            
+            token = lexer.getNextToken();
+            if (options.acceptCommaAfterLastEntry && token.type == Token::Type::RIGHT_SQUARE_BRACKET)
+                return true;
+        }
+    }
+    
+    //! Parse text that holds an array on multiple threads, if the options ask for it
+    /*! Every thread parses a group of consecutive elements, moving each into its place in the array.
+        @return false if the text wasn't parsed, or contains an error. Parsing it on a single thread
+                then finds out which, and where. */
+    static bool tryParseInParallel(std::string_view text, const ParseOptions& options, Value& value)
+    {
+        const auto& parallel = options.parallel;
+        if (parallel.arrayThreshold == 0 || text.size() < parallel.arrayThreshold || options.maxDepth == 0)
+            return false;
+        
+        std::vector<std::string_view> elements;
+        if (!findElements(text, options, elements))
+            return false;
+        
+        // Group the elements, so that each task is worth handing to a thread
+        std::vector<std::pair<std::size_t, std::size_t>> groups;
+        for (std::size_t first = 0; first < elements.size();)
+        {
+            auto last = first;
+            std::size_t size = 0;
+            do
+                size += elements[last++].size();
+            while (last < elements.size() && size < parallel.chunkSize);
+            
+            groups.emplace_back(first, last);
+            first = last;
+        }
+        
+        // The array itself counts towards the depth of the elements
+        auto elementOptions = options;
+        --elementOptions.maxDepth;
+        
+        Value::Array array(elements.size());
+        std::atomic<bool> failed = false;
+        
+        // Anything other than a parsing error that a thread throws, such as std::bad_alloc, is rethrown here
+        std::exception_ptr exception;
+        
+        std::mutex mutex;
+        std::condition_variable finished;
+        auto remaining = groups.size();
+        
+        {
+            // The threads are stopped at the end of this scope, before anything they use goes away
+            ThreadPool pool(parallel.threadCount);
+            for (const auto& group : groups)
+            {
+                pool.submit([&, group]
+                {
+                    Lexer lexer{std::string_view()};
+                    Parser parser(lexer);
+                    configure(lexer, parser, elementOptions);
+                    
+                    std::exception_ptr thrown;
+                    try
+                    {
+                        for (auto i = group.first; i < group.second && !failed; ++i)
+                        {
+                            lexer.reset(elements[i]);
+                            
+                            auto result = parser.tryParse();
+                            if (!result || parser.expectEnd())
+                            {
+                                failed = true;
+                                break;
+                            }
+                            
+                            array[i] = std::move(result.value);
+                        }
+                    } catch (...) {
+                        thrown = std::current_exception();
+                        failed = true;
+                    }
+                    
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (thrown && !exception)
+                        exception = thrown;
+                    
+                    if (--remaining == 0)
+                        finished.notify_one();
+                });
+            }
+            
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&] { return remaining == 0; });
+        }
+        
+        if (exception)
+            std::rethrow_exception(exception);
+        
+        if (failed)
+            return false;
+        
+        value = std::move(array);
+        return true;
+    }
+    
+    ParseResult tryParse(std::istream& stream, const ParseOptions& options)
+    {
         Lexer lexer(stream);
         Parser parser(lexer);
-        return parser.parse();
-	}
+        configure(lexer, parser, options);
+        return parser.tryParse();
+    }
+    
+    ParseResult tryParse(std::string_view text, const ParseOptions& options)
+    {
+        if (ParseResult result; tryParseInParallel(text, options, result.value))
+            return result;
+        
+        Lexer lexer(text);
+        Parser parser(lexer);
+        configure(lexer, parser, options);
+        return parser.tryParse();
+    }
+    
+    ParseResult tryParse(const char* data, std::size_t size, const ParseOptions& options)
+    {
+        return tryParse(std::string_view(data, size), options);
+    }
+    
+    ParseResult tryParse(std::string_view text, Arena& arena, const ParseOptions& options)
+    {
+        Lexer lexer(text);
+        Parser parser(lexer);
+        configure(lexer, parser, options);
+        return parser.tryParse(arena);
+    }
+    
+    void parse(std::istream& stream, Handler& handler, const ParseOptions& options)
+    {
+        if (const auto error = tryParse(stream, handler, options))
+            throw Error(error);
+    }
+    
+    void parse(std::string_view text, Handler& handler, const ParseOptions& options)
+    {
+        if (const auto error = tryParse(text, handler, options))
+            throw Error(error);
+    }
+    
+    ParseError tryParse(std::istream& stream, Handler& handler, const ParseOptions& options)
+    {
+        Lexer lexer(stream);
+        Parser parser(lexer);
+        configure(lexer, parser, options);
+        return parser.tryParse(handler);
+    }
+    
+    ParseError tryParse(std::string_view text, Handler& handler, const ParseOptions& options)
+    {
+        Lexer lexer(text);
+        Parser parser(lexer);
+        configure(lexer, parser, options);
+        return parser.tryParse(handler);
+    }
+    
+    Value parseFile(const std::string& path, const ParseOptions& options)
+    {
+        return unwrap(tryParseFile(path, options));
+    }
+    
+    ParseResult tryParseFile(const std::string& path, const ParseOptions& options)
+    {
+        const MappedFile file(path);
+        return tryParse(file.getText(), options);
+    }
+    
+    void parseFile(const std::string& path, Handler& handler, const ParseOptions& options)
+    {
+        if (const auto error = tryParseFile(path, handler, options))
+            throw Error(error);
+    }
     
-    Value parse(const std::string& text)
+    ParseError tryParseFile(const std::string& path, Handler& handler, const ParseOptions& options)
     {
-        istringstream stream(text);
-        return parse(stream);
+        const MappedFile file(path);
+        return tryParse(file.getText(), handler, options);
     }
     
     istream& operator>>(std::istream& stream, Value& value)
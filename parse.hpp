@@ -9,22 +9,145 @@
 #ifndef JSON_PARSE_HPP
 #define JSON_PARSE_HPP
 
+#include <cstddef>
 #include <istream>
 #include <string>
+#include <string_view>
 
+#include "arena.hpp"
+#include "error.hpp"
+#include "handler.hpp"
 #include "value.hpp"
 
 namespace json
 {
+    //! Settings that control how input is parsed on multiple threads
+    struct ParallelOptions
+    {
+        //! The number of threads that parse, or 0 for one per hardware thread
+        std::size_t threadCount = 0;
+        
+        //! The number of bytes that a thread parses at once
+        /*! Chunks of newline-delimited Json are extended up to the end of the line they end in */
+        std::size_t chunkSize = 256 * 1024;
+        
+        //! Are records delivered in the order in which they appear in the input?
+        /*! Otherwise the records of a chunk are delivered as soon as it has been parsed */
+        bool ordered = true;
+        
+        //! The maximum number of chunks that are being parsed, or waiting to be delivered, or 0 for four per thread
+        /*! When records are delivered slower than they're parsed, this bounds the memory that is used */
+        std::size_t maxChunksInFlight = 0;
+        
+        //! The size from which parse() splits text that holds an array over multiple threads, or 0 to never do so
+        /*! The elements of the array are found by matching brackets, after which groups of them (of about
+            chunkSize bytes) are parsed in parallel, straight into the resulting array. Below this size,
+            that doesn't make up for starting the threads. Only applies to building Values from contiguous text. */
+        std::size_t arrayThreshold = 0;
+    };
+    
+    //! Settings that control how lenient and how thorough parsing is
+    struct ParseOptions
+    {
+        //! Do we accept comments, even though they are not part of the specification?
+        bool acceptComments = true;
+        
+        //! Do we accept a comma after the last entry of an object or array?
+        bool acceptCommaAfterLastEntry = true;
+        
+        //! Do we check that strings are valid UTF-8?
+        bool validateUtf8 = false;
+        
+        //! The maximum number of arrays and objects that can be nested in each other
+        std::size_t maxDepth = 1024;
+        
+        //! How parsing is spread over multiple threads, where it can be
+        ParallelOptions parallel;
+    };
+    
+    //! The outcome of parsing without exceptions: either a value, or an error
+    struct ParseResult
+    {
+        //! Did parsing succeed?
+        explicit operator bool() const { return !error; }
+        
+        //! The parsed value, or null if parsing failed
+        Value value;
+        
+        //! What went wrong, if anything
+        ParseError error;
+    };
+	
 	//! Parse a Json value from stream
-	/*! @throw std::runtime_error in case of parsing errors */
-	Value parse(std::istream& stream);
+	/*! @throw json::Error (a std::runtime_error) in case of parsing errors */
+	Value parse(std::istream& stream, const ParseOptions& options = {});
     
     //! Parse a Json value from text
-    /*! @throw std::runtime_error in case of parsing errors */
-    Value parse(const std::string& text);
+    /*! @throw json::Error (a std::runtime_error) in case of parsing errors */
+    Value parse(std::string_view text, const ParseOptions& options = {});
+    
+    //! Parse a Json value from a block of memory
+    /*! @throw json::Error (a std::runtime_error) in case of parsing errors */
+    Value parse(const char* data, std::size_t size, const ParseOptions& options = {});
+    
+    //! Parse a Json value from stream, without throwing in case of parsing errors
+    ParseResult tryParse(std::istream& stream, const ParseOptions& options = {});
+    
+    //! Parse a Json value from text, without throwing in case of parsing errors
+    ParseResult tryParse(std::string_view text, const ParseOptions& options = {});
+    
+    //! Parse a Json value from a block of memory, without throwing in case of parsing errors
+    ParseResult tryParse(const char* data, std::size_t size, const ParseOptions& options = {});
+    
+    //! Parse a Json value from text, allocating its long strings, arrays and objects from an arena
+    /*! Releasing the arena then frees the whole value at once, without visiting it. Arrays and objects that
+        were changed after parsing (through non-const access to their elements) are still visited, so that
+        whatever was put in them outside of the arena is freed. Parsing with an arena never uses threads.
+        @throw json::Error (a std::runtime_error) in case of parsing errors
+        @warning The value should be destructed or reset before the arena is released */
+    Value parse(std::string_view text, Arena& arena, const ParseOptions& options = {});
+    
+    //! Parse a Json value from text, allocating from an arena, without throwing in case of parsing errors
+    /*! @warning The value should be destructed or reset before the arena is released */
+    ParseResult tryParse(std::string_view text, Arena& arena, const ParseOptions& options = {});
+    
+    //! Parse Json from stream, reporting its contents to a handler instead of building a value
+    /*! @throw json::Error (a std::runtime_error) in case of parsing errors */
+    void parse(std::istream& stream, Handler& handler, const ParseOptions& options = {});
+    
+    //! Parse Json text, reporting its contents to a handler instead of building a value
+    /*! @throw json::Error (a std::runtime_error) in case of parsing errors */
+    void parse(std::string_view text, Handler& handler, const ParseOptions& options = {});
+    
+    //! Parse Json from stream, reporting its contents to a handler, without throwing in case of parsing errors
+    /*! The handler will have received the events up until the error */
+    ParseError tryParse(std::istream& stream, Handler& handler, const ParseOptions& options = {});
+    
+    //! Parse Json text, reporting its contents to a handler, without throwing in case of parsing errors
+    /*! The handler will have received the events up until the error */
+    ParseError tryParse(std::string_view text, Handler& handler, const ParseOptions& options = {});
+    
+    //! Parse a Json value from a file
+    /*! Regular files are memory-mapped and parsed in place, like text. Other files, such as pipes, are read into memory first.
+        @throw json::Error (a std::runtime_error) in case of parsing errors, std::system_error if the file can't be read
+        @warning The file shouldn't shrink while it is parsed */
+    Value parseFile(const std::string& path, const ParseOptions& options = {});
+    
+    //! Parse a Json value from a file, without throwing in case of parsing errors
+    /*! @throw std::system_error if the file can't be read */
+    ParseResult tryParseFile(const std::string& path, const ParseOptions& options = {});
+    
+    //! Parse Json from a file, reporting its contents to a handler instead of building a value
+    /*! @throw json::Error (a std::runtime_error) in case of parsing errors, std::system_error if the file can't be read */
+    void parseFile(const std::string& path, Handler& handler, const ParseOptions& options = {});
+    
+    //! Parse Json from a file, reporting its contents to a handler, without throwing in case of parsing errors
+    /*! The handler will have received the events up until the error
+        @throw std::system_error if the file can't be read */
+    ParseError tryParseFile(const std::string& path, Handler& handler, const ParseOptions& options = {});
     
     //! Parse a json value from stream
+    /*! This sets up a new lexer and parser for every value. To read many values in a row, use a json::LineReader. */
     std::istream& operator>>(std::istream& stream, Value& value);
 }
 
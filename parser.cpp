@@ -5,8 +5,13 @@
 //  Created by Stijn Frishert on 12/20/18.
 //
 
-#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "builder.hpp"
+#include "error.hpp"
 #include "lexer.hpp"
 #include "parser.hpp"
 
@@ -20,90 +25,259 @@ namespace json
     
     Value Parser::parse()
     {
-        return parse(lexer.getNextToken());
+        auto result = tryParse();
+        if (!result)
+            throw Error(result.error);
+        
+        return std::move(result.value);
     }
     
-    Value Parser::parse(const Token& token)
+    ParseResult Parser::tryParse()
     {
-        switch (token.type)
+        return tryParse(lexer.getNextToken());
+    }
+    
+    ParseResult Parser::tryParse(const Token& first)
+    {
+        return build(first, nullptr);
+    }
+    
+    ParseResult Parser::tryParse(Arena& arena)
+    {
+        return build(lexer.getNextToken(), &arena);
+    }
+    
+    ParseResult Parser::build(const Token& first, Arena* arena)
+    {
+        ParseResult result;
+        error = {};
+        
+        ValueBuilder builder(result.value, arena);
+        if (!parse(first, builder))
         {
-            case Token::Type::LEFT_ACCOLADE: return parseObject();
-            case Token::Type::LEFT_SQUARE_BRACKET: return parseArray();
-            case Token::Type::STRING: return token.lexeme;
-            case Token::Type::NUMBER: return parseNumber(token.lexeme);
-            case Token::Type::BOOL_TRUE: return true;
-            case Token::Type::BOOL_FALSE: return false;
-            case Token::Type::NIL: return json::Value::null;
-            default: throw std::runtime_error("Unexpected token");
+            locateError();
+            result.value = Value::null;
+            result.error = error;
         }
+        
+        return result;
+    }
+    
+    ParseError Parser::tryParse(ValueBuilder& builder)
+    {
+        error = {};
+        builder.reset();
+        
+        if (!parse(lexer.getNextToken(), builder))
+            locateError();
+        
+        return error;
     }
     
-    Value Parser::parseObject()
+    void Parser::parse(Handler& handler)
     {
-        auto object = json::Value::emptyObject;
+        if (const auto error = tryParse(handler))
+            throw Error(error);
+    }
+    
+    ParseError Parser::tryParse(Handler& handler)
+    {
+        error = {};
         
-        auto token = lexer.getNextToken();
-        if (token.type == Token::Type::RIGHT_ACCOLADE)
-            return object;
+        if (!parse(lexer.getNextToken(), handler))
+            locateError();
         
-        while (true)
+        return error;
+    }
+    
+    ParseError Parser::expectEnd()
+    {
+        error = {};
+        
+        if (const auto token = lexer.getNextToken(); token.type != Token::Type::END_OF_FILE)
         {
-            if (token.type != Token::Type::STRING)
-                throw std::runtime_error("Unexpected token");
-            
-            const auto key = token.lexeme;
-            if (lexer.getNextToken().type != Token::Type::COLON)
-                throw std::runtime_error("Expected : after an object key");
-            
-            object.insert(key, parse());
-            
-            token = lexer.getNextToken();
-            if (token.type == Token::Type::RIGHT_ACCOLADE)
-                break;
-            else if (token.type != Token::Type::COMMA)
-                throw std::runtime_error("Object fields must be seperated by ,");
-            
-            token = lexer.getNextToken();
-            
-            if (acceptCommaAfterLastEntry && token.type == Token::Type::RIGHT_ACCOLADE)
-                break;
+            fail(token, ErrorCode::UNEXPECTED_TOKEN);
+            locateError();
         }
         
-        return object;
+        return error;
     }
     
-    Value Parser::parseArray()
+    ParseError Parser::resume(Handler& handler)
     {
-        auto array = json::Value::emptyArray;
+        // After an error, we can't pick up where we left off
+        if (!error && state != State::COMPLETE && !advance(lexer.getNextToken(), handler))
+            locateError();
         
-        auto token = lexer.getNextToken();
-        if (token.type == Token::Type::RIGHT_SQUARE_BRACKET)
-            return array;
-        
-        while (true)
+        return error;
+    }
+    
+    void Parser::restart()
+    {
+        state = State::VALUE;
+        stack.clear();
+        error = {};
+    }
+    
+    bool Parser::isComplete() const
+    {
+        return state == State::COMPLETE;
+    }
+    
+    template <class Builder>
+    bool Parser::parse(Token token, Builder& builder)
+    {
+        restart();
+        return advance(token, builder);
+    }
+    
+    template <class Builder>
+    bool Parser::advance(Token token, Builder& builder)
+    {
+        // Every iteration handles one token, according to what we expect at this point of the grammar.
+        // Nesting is tracked in `stack`, so that deep input can't overflow the call stack.
+        while (token.type != Token::Type::INCOMPLETE)
         {
-            array.append(parse(token));
+            switch (state)
+            {
+                case State::VALUE:
+                    if (!value(token, builder))
+                        return false;
+                    
+                    break;
+                
+                case State::OPENED:
+                case State::ELEMENT:
+                    // A container can end right after it opened, or after a comma if we accept that
+                    if (token.type == stack.back() && (state == State::OPENED || acceptCommaAfterLastEntry))
+                    {
+                        close(builder);
+                        break;
+                    }
+                    
+                    if (stack.back() == Token::Type::RIGHT_SQUARE_BRACKET)
+                    {
+                        if (!value(token, builder))
+                            return false;
+                        
+                        break;
+                    }
+                    
+                    if (token.type != Token::Type::STRING)
+                        return fail(token, ErrorCode::EXPECTED_KEY);
+                    
+                    // The lexeme is only valid until the next token, so report the key before reading on
+                    builder.key(token.lexeme);
+                    state = State::COLON;
+                    break;
+                
+                case State::COLON:
+                    if (token.type != Token::Type::COLON)
+                        return fail(token, ErrorCode::EXPECTED_COLON);
+                    
+                    state = State::VALUE;
+                    break;
+                
+                case State::SEPARATOR:
+                    if (token.type == stack.back())
+                        close(builder);
+                    else if (token.type == Token::Type::COMMA)
+                        state = State::ELEMENT;
+                    else
+                        return fail(token, stack.back() == Token::Type::RIGHT_ACCOLADE ? ErrorCode::EXPECTED_OBJECT_SEPARATOR : ErrorCode::EXPECTED_ARRAY_SEPARATOR);
+                    
+                    break;
+                
+                case State::COMPLETE:
+                    break;
+            }
             
-            token = lexer.getNextToken();
-            if (token.type == Token::Type::RIGHT_SQUARE_BRACKET)
-                break;
-            else if (token.type != Token::Type::COMMA)
-                throw std::runtime_error("Array fields must be seperated by ,");
+            if (state == State::COMPLETE)
+                return true;
             
             token = lexer.getNextToken();
+        }
+        
+        // The lexer ran out of input halfway, so we'll continue from here once it has been fed more
+        return true;
+    }
+    
+    template <class Builder>
+    bool Parser::value(const Token& token, Builder& builder)
+    {
+        switch (token.type)
+        {
+            case Token::Type::LEFT_ACCOLADE:
+                if (stack.size() >= maxDepth)
+                    return fail(token, ErrorCode::TOO_DEEP);
+                
+                builder.startObject();
+                stack.push_back(Token::Type::RIGHT_ACCOLADE);
+                state = State::OPENED;
+                return true;
             
-            if (acceptCommaAfterLastEntry && token.type == Token::Type::RIGHT_SQUARE_BRACKET)
-                break;
+            case Token::Type::LEFT_SQUARE_BRACKET:
+                if (stack.size() >= maxDepth)
+                    return fail(token, ErrorCode::TOO_DEEP);
+                
+                builder.startArray();
+                stack.push_back(Token::Type::RIGHT_SQUARE_BRACKET);
+                state = State::OPENED;
+                return true;
+            
+            case Token::Type::STRING: builder.string(token.lexeme); break;
+            case Token::Type::NUMBER: number(token, builder); break;
+            case Token::Type::BOOL_TRUE: builder.boolean(true); break;
+            case Token::Type::BOOL_FALSE: builder.boolean(false); break;
+            case Token::Type::NIL: builder.null(); break;
+            default: return fail(token, ErrorCode::UNEXPECTED_TOKEN);
         }
         
-        return array;
+        state = stack.empty() ? State::COMPLETE : State::SEPARATOR;
+        return true;
+    }
+    
+    template <class Builder>
+    void Parser::number(const Token& token, Builder& builder)
+    {
+        switch (token.numberType)
+        {
+            case Token::NumberType::SIGNED: builder.int64(token.signedInteger); break;
+            case Token::NumberType::UNSIGNED: builder.uint64(token.unsignedInteger); break;
+            case Token::NumberType::REAL: builder.real(token.real); break;
+        }
     }
     
-    Value Parser::parseNumber(std::string_view lexeme)
+    template <class Builder>
+    void Parser::close(Builder& builder)
     {
-        if (std::any_of(lexeme.begin(), lexeme.end(), [](auto c){ return c == '.'; }))
-            return std::stold(std::string(lexeme));
+        if (stack.back() == Token::Type::RIGHT_ACCOLADE)
+            builder.endObject();
         else
-            return std::stoll(std::string(lexeme));
+            builder.endArray();
+        
+        stack.pop_back();
+        state = stack.empty() ? State::COMPLETE : State::SEPARATOR;
+    }
+    
+    void Parser::locateError()
+    {
+        // Only now that something went wrong, figure out where that happened
+        const auto position = lexer.getPosition(error.offset);
+        error.line = position.line;
+        error.character = position.character;
+    }
+    
+    bool Parser::fail(const Token& token, ErrorCode code)
+    {
+        // Running out of input, or into something the lexer didn't understand, is the more precise explanation
+        if (token.type == Token::Type::END_OF_FILE)
+            code = ErrorCode::UNEXPECTED_END_OF_INPUT;
+        else if (token.type == Token::Type::UNKNOWN)
+            code = token.error;
+        
+        error.code = code;
+        error.offset = token.offset;
+        return false;
     }
 }
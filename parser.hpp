@@ -7,35 +7,139 @@
 
 #pragma once
 
+#include <cstddef>
 #include <string>
+#include <string_view>
+#include <vector>
 
+#include "arena.hpp"
+#include "error.hpp"
+#include "handler.hpp"
+#include "parse.hpp"
+#include "token.hpp"
 #include "value.hpp"
 
 namespace json
 {
     class Lexer;
-    class Token;
+    class ValueBuilder;
     
     class Parser
     {
     public:
         Parser(Lexer& lexer);
         
+        //! Parse a value
+        /*! @throw json::Error in case of parsing errors */
         [[nodiscard]] Value parse();
         
+        //! Parse a value, reporting errors through the result instead of throwing
+        [[nodiscard]] ParseResult tryParse();
+        
+        //! Parse a value whose first token has already been read from the lexer, e.g. by a Cursor
+        [[nodiscard]] ParseResult tryParse(const Token& first);
+        
+        //! Parse a value, allocating its long strings, arrays and objects from an arena
+        /*! @warning The value should be destructed before the arena is released */
+        [[nodiscard]] ParseResult tryParse(Arena& arena);
+        
+        //! Parse a value into the root of a builder, which is reset first
+        /*! The builder is kept by the caller, so that its scratch space is reused between values.
+            The root is left as it was built up until an error, if any. */
+        [[nodiscard]] ParseError tryParse(ValueBuilder& builder);
+        
+        //! Parse a value, reporting its contents to a handler instead of building it
+        /*! @throw json::Error in case of parsing errors */
+        void parse(Handler& handler);
+        
+        //! Parse a value, reporting its contents to a handler, and errors through the result instead of throwing
+        /*! The handler will have received the events up until the error */
+        [[nodiscard]] ParseError tryParse(Handler& handler);
+        
+        //! Check that nothing but whitespace and comments follows the value that was parsed
+        /*! @return ErrorCode::UNEXPECTED_TOKEN (or a lexing error) if something else does */
+        [[nodiscard]] ParseError expectEnd();
+        
+        //! Continue parsing a value, with the input that the lexer has been fed so far
+        /*! For lexers that are fed their input in chunks (see Lexer::feed()), which can run out halfway
+            a value. Every call picks up where the previous one left off, until isComplete().
+            @return What went wrong, if anything. The handler will have received the events up until then,
+                    and the error is returned again until restart(). */
+        [[nodiscard]] ParseError resume(Handler& handler);
+        
+        //! Forget about the value being parsed, so that resume() starts on a new one
+        void restart();
+        
+        //! Has resume() parsed a complete value?
+        bool isComplete() const;
+        
     public:
         //! Do we accept a comma after the last entry of an object or array?
         /*! Technically this is not correct Json, but happens often with copy/paste json
             and there's no harm in accepting this. */
         bool acceptCommaAfterLastEntry = true;
         
+        //! The maximum number of arrays and objects that can be nested in each other
+        /*! Deeper input is rejected with ErrorCode::TOO_DEEP, before building any of it */
+        std::size_t maxDepth = 1024;
+        
+    private:
+        //! What the parser expects the next token to be
+        enum class State
+        {
+            VALUE,      //!< The start of a value
+            OPENED,     //!< The first element of the container that was just opened, or its end
+            COLON,      //!< The colon after a key
+            SEPARATOR,  //!< A comma, or the end of the container
+            ELEMENT,    //!< The element after a comma
+            COMPLETE    //!< Nothing, as the value is complete
+        };
+        
     private:
-        [[nodiscard]] Value parse(const Token& token);
-        [[nodiscard]] Value parseObject();
-        [[nodiscard]] Value parseArray();
-        [[nodiscard]] Value parseNumber(std::string_view lexeme);
+        // The parser reports what it encounters to a builder, which is either a Handler, or
+        // something with the same member functions. These return false on errors, after
+        // storing it in `error`.
+        
+        template <class Builder>
+        [[nodiscard]] bool parse(Token token, Builder& builder);
+        
+        //! Handle tokens, starting with the one given, until the value is complete or the lexer runs out of input
+        template <class Builder>
+        [[nodiscard]] bool advance(Token token, Builder& builder);
+        
+        //! Handle the first token of a value
+        template <class Builder>
+        [[nodiscard]] bool value(const Token& token, Builder& builder);
+        
+        template <class Builder>
+        void number(const Token& token, Builder& builder);
+        
+        //! Close the innermost container
+        template <class Builder>
+        void close(Builder& builder);
+        
+        //! Parse a value into a result, allocating from an arena if there is one
+        ParseResult build(const Token& first, Arena* arena);
+        
+        //! Compute the line and character of the error
+        void locateError();
+        
+        //! Store an error, pointing at the token that caused it
+        /*! @return false, so that it can be returned straight away */
+        bool fail(const Token& token, ErrorCode code);
         
     private:
         Lexer& lexer;
+        
+        //! The error that made parsing fail
+        ParseError error;
+        
+        //! Where we are in the grammar, so that parsing can be resumed
+        State state = State::VALUE;
+        
+        //! The tokens that close the arrays and objects that are being parsed, innermost last
+        /*! Nesting is tracked here instead of on the call stack, so that deep input can't overflow it.
+            Kept between parses, so that it only allocates while growing. */
+        std::vector<Token::Type> stack;
     };
 }
@@ -0,0 +1,78 @@
+//
+//  push_parser.cpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#include <stdexcept>
+#include <utility>
+
+#include "error.hpp"
+#include "push_parser.hpp"
+
+using namespace std;
+
+namespace json
+{
+    PushParser::PushParser(const ParseOptions& options) :
+        PushParser(builder, options)
+    {
+        
+    }
+    
+    PushParser::PushParser(Handler& handler, const ParseOptions& options) :
+        parser(lexer),
+        builder(value),
+        handler(handler)
+    {
+        lexer.acceptComments = options.acceptComments;
+        lexer.validateUtf8 = options.validateUtf8;
+        parser.acceptCommaAfterLastEntry = options.acceptCommaAfterLastEntry;
+        parser.maxDepth = options.maxDepth;
+    }
+    
+    bool PushParser::feed(const char* data, std::size_t size)
+    {
+        lexer.feed(data, size);
+        return advance();
+    }
+    
+    bool PushParser::feed(string_view chunk)
+    {
+        return feed(chunk.data(), chunk.size());
+    }
+    
+    bool PushParser::finish()
+    {
+        lexer.finish();
+        return advance();
+    }
+    
+    bool PushParser::isComplete() const
+    {
+        return parser.isComplete();
+    }
+    
+    Value PushParser::takeValue()
+    {
+        if (!parser.isComplete())
+            throw runtime_error("The Json value hasn't been parsed completely, yet takeValue() was called");
+        
+        auto result = std::move(value);
+        value = Value::null;
+        
+        builder.reset();
+        parser.restart();
+        return result;
+    }
+    
+    bool PushParser::advance()
+    {
+        if (const auto error = parser.resume(handler))
+            throw Error(error);
+        
+        return parser.isComplete();
+    }
+}
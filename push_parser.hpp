@@ -0,0 +1,90 @@
+//
+//  push_parser.hpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#ifndef JSON_PUSH_PARSER_HPP
+#define JSON_PUSH_PARSER_HPP
+
+#include <cstddef>
+#include <string_view>
+
+#include "builder.hpp"
+#include "handler.hpp"
+#include "lexer.hpp"
+#include "parse.hpp"
+#include "parser.hpp"
+#include "value.hpp"
+
+namespace json
+{
+    //! Parses Json that arrives in chunks, as it arrives
+    /*! Chunks can end anywhere, even halfway a string, number or escape sequence. Only the bytes of
+        such an unfinished token are kept until the next chunk, everything before it has been parsed.
+        
+        @code
+        json::PushParser parser;
+        while (receive(chunk))
+        {
+            if (parser.feed(chunk))
+                break;
+        }
+        
+        if (parser.finish())
+            use(parser.takeValue());
+        @endcode */
+    class PushParser
+    {
+    public:
+        //! Parse the input into Values
+        PushParser(const ParseOptions& options = {});
+        
+        //! Report the input to a handler, instead of building Values
+        /*! @warning The handler should outlive the parser */
+        PushParser(Handler& handler, const ParseOptions& options = {});
+        
+        PushParser(const PushParser&) = delete;
+        PushParser& operator=(const PushParser&) = delete;
+        
+        //! Parse the next chunk of input
+        /*! @return true once a complete value has been parsed. Anything fed after that is kept for the next value.
+            @throw json::Error in case of parsing errors, after which the parser can't continue */
+        bool feed(const char* data, std::size_t size);
+        bool feed(std::string_view chunk);
+        
+        //! Signal that no more input follows
+        /*! This completes a value that ends with a number, as that can't be known before
+            @return true if a complete value has been parsed
+            @throw json::Error if the input ended halfway a value */
+        bool finish();
+        
+        //! Has a complete value been parsed?
+        bool isComplete() const;
+        
+        //! Return the value that was parsed, and move on to the next one
+        /*! Input that was fed after the value is parsed by the next call to feed(), which can be
+            empty. When reporting to a handler, the value is always null.
+            @throw std::runtime_error if the value isn't complete yet */
+        Value takeValue();
+        
+    private:
+        //! Parse what the lexer has been fed so far
+        bool advance();
+        
+    private:
+        Lexer lexer;
+        Parser parser;
+        
+        //! The value being built, unless we report to a handler
+        Value value;
+        ValueBuilder builder;
+        
+        //! Receives what the parser encounters, which is the builder by default
+        Handler& handler;
+    };
+}
+
+#endif
@@ -0,0 +1,24 @@
+//
+//  real.hpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#ifndef JSON_REAL_HPP
+#define JSON_REAL_HPP
+
+namespace json
+{
+    //! The type in which real numbers are decoded, reported to handlers and stored in values
+    /*! This is double, unless JSON_LONG_DOUBLE_REALS is defined, which grows values to 24 bytes. The
+        library and the code using it should agree on the definition (see the CMake option of that name). */
+#ifdef JSON_LONG_DOUBLE_REALS
+    using Real = long double;
+#else
+    using Real = double;
+#endif
+}
+
+#endif
@@ -0,0 +1,403 @@
+//
+//  simd.cpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define JSON_SIMD_X86 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#include "simd.hpp"
+
+namespace json
+{
+    //! A set of implementations of the vectorized routines, for one SimdLevel
+    struct Kernels
+    {
+        SimdLevel level;
+        const char* (*findStringSpecial)(const char* begin, const char* end);
+        const char* (*skipWhitespace)(const char* begin, const char* end);
+        bool (*validateUtf8)(const char* begin, const char* end);
+    };
+    
+    //! Lookup table for the bytes that end a run of string content
+    static constexpr auto stringSpecials = []
+    {
+        std::array<bool, 256> table = {};
+        for (auto c = 0; c < 0x20; ++c)
+            table[c] = true;
+        
+        table['"'] = true;
+        table['\\'] = true;
+        return table;
+    }();
+    
+    // Scalar implementations. These are also used by the vectorized ones for the bytes that
+    // don't fill up a whole register.
+    
+    const char* findStringSpecialScalar(const char* begin, const char* end)
+    {
+        while (begin != end && !stringSpecials[static_cast<unsigned char>(*begin)])
+            ++begin;
+        
+        return begin;
+    }
+    
+    const char* skipWhitespaceScalar(const char* begin, const char* end)
+    {
+        while (begin != end && isWhitespace(*begin))
+            ++begin;
+        
+        return begin;
+    }
+    
+    bool validateUtf8Scalar(const char* begin, const char* end)
+    {
+        const auto* bytes = reinterpret_cast<const unsigned char*>(begin);
+        const auto* last = reinterpret_cast<const unsigned char*>(end);
+        
+        while (bytes != last)
+        {
+            // Skip runs of ASCII eight bytes at a time
+            if (last - bytes >= 8)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, bytes, sizeof(word));
+                if ((word & 0x8080808080808080) == 0)
+                {
+                    bytes += 8;
+                    continue;
+                }
+            }
+            
+            const auto lead = *bytes;
+            if (lead < 0x80)
+            {
+                ++bytes;
+                continue;
+            }
+            
+            // The range of the second byte excludes overlong encodings, surrogates and code points above U+10FFFF
+            std::ptrdiff_t length = 0;
+            unsigned char low = 0x80;
+            unsigned char high = 0xBF;
+            
+            if (lead >= 0xC2 && lead <= 0xDF)
+                length = 2;
+            else if (lead == 0xE0)
+                length = 3, low = 0xA0;
+            else if (lead == 0xED)
+                length = 3, high = 0x9F;
+            else if (lead >= 0xE1 && lead <= 0xEF)
+                length = 3;
+            else if (lead == 0xF0)
+                length = 4, low = 0x90;
+            else if (lead == 0xF4)
+                length = 4, high = 0x8F;
+            else if (lead >= 0xF1 && lead <= 0xF3)
+                length = 4;
+            else
+                return false;
+            
+            if (last - bytes < length || bytes[1] < low || bytes[1] > high)
+                return false;
+            
+            for (auto i = 2; i < length; ++i)
+            {
+                if ((bytes[i] & 0xC0) != 0x80)
+                    return false;
+            }
+            
+            bytes += length;
+        }
+        
+        return true;
+    }
+    
+    static constexpr Kernels scalarKernels = { SimdLevel::SCALAR, findStringSpecialScalar, skipWhitespaceScalar, validateUtf8Scalar };
+
+#if JSON_SIMD_X86
+    
+    // Lookup tables for validating UTF-8 with byte shuffles, after Keiser & Lemire, "Validating UTF-8 In
+    // Less Than One Instruction Per Byte". Every byte is classified by the high and low nibble of the byte
+    // before it, and by its own high nibble. Each bit stands for one kind of error, which only occurs if it
+    // is set in all three lookups. Missing and superfluous third and fourth continuation bytes are caught
+    // separately, by comparing with the bytes two and three places back.
+    
+    static constexpr std::uint8_t utf8TooShort = 1 << 0;         // 11______ 0_______, 11______ 11______
+    static constexpr std::uint8_t utf8TooLong = 1 << 1;          // 0_______ 10______
+    static constexpr std::uint8_t utf8Overlong3 = 1 << 2;        // 11100000 100_____
+    static constexpr std::uint8_t utf8TooLarge = 1 << 3;         // 11110100 1001____, 11110100 101_____, 111101__ 1001____, ...
+    static constexpr std::uint8_t utf8Surrogate = 1 << 4;        // 11101101 101_____
+    static constexpr std::uint8_t utf8Overlong2 = 1 << 5;        // 1100000_ 10______
+    static constexpr std::uint8_t utf8TooLarge1000 = 1 << 6;     // 11110101 1000____, 1111011_ 1000____, 11111___ 1000____
+    static constexpr std::uint8_t utf8Overlong4 = 1 << 6;        // 11110000 1000____
+    static constexpr std::uint8_t utf8TwoContinuations = 1 << 7; // 10______ 10______
+    static constexpr std::uint8_t utf8Carry = utf8TooShort | utf8TooLong | utf8TwoContinuations;
+    
+    extern const std::uint8_t utf8PreviousHighNibble[16] =
+    {
+        // ASCII
+        utf8TooLong, utf8TooLong, utf8TooLong, utf8TooLong, utf8TooLong, utf8TooLong, utf8TooLong, utf8TooLong,
+        
+        // Continuation
+        utf8TwoContinuations, utf8TwoContinuations, utf8TwoContinuations, utf8TwoContinuations,
+        
+        // Leads of two, three and four bytes
+        utf8TooShort | utf8Overlong2,
+        utf8TooShort,
+        utf8TooShort | utf8Overlong3 | utf8Surrogate,
+        utf8TooShort | utf8TooLarge | utf8TooLarge1000 | utf8Overlong4
+    };
+    
+    extern const std::uint8_t utf8PreviousLowNibble[16] =
+    {
+        utf8Carry | utf8Overlong3 | utf8Overlong2 | utf8Overlong4,
+        utf8Carry | utf8Overlong2,
+        utf8Carry,
+        utf8Carry,
+        utf8Carry | utf8TooLarge,
+        utf8Carry | utf8TooLarge | utf8TooLarge1000,
+        utf8Carry | utf8TooLarge | utf8TooLarge1000,
+        utf8Carry | utf8TooLarge | utf8TooLarge1000,
+        utf8Carry | utf8TooLarge | utf8TooLarge1000,
+        utf8Carry | utf8TooLarge | utf8TooLarge1000,
+        utf8Carry | utf8TooLarge | utf8TooLarge1000,
+        utf8Carry | utf8TooLarge | utf8TooLarge1000,
+        utf8Carry | utf8TooLarge | utf8TooLarge1000,
+        utf8Carry | utf8TooLarge | utf8TooLarge1000 | utf8Surrogate,
+        utf8Carry | utf8TooLarge | utf8TooLarge1000,
+        utf8Carry | utf8TooLarge | utf8TooLarge1000
+    };
+    
+    extern const std::uint8_t utf8CurrentHighNibble[16] =
+    {
+        // ASCII
+        utf8TooShort, utf8TooShort, utf8TooShort, utf8TooShort, utf8TooShort, utf8TooShort, utf8TooShort, utf8TooShort,
+        
+        // Continuations 1000____, 1001____ and 101_____
+        utf8TooLong | utf8Overlong2 | utf8TwoContinuations | utf8Overlong3 | utf8TooLarge1000 | utf8Overlong4,
+        utf8TooLong | utf8Overlong2 | utf8TwoContinuations | utf8Overlong3 | utf8TooLarge,
+        utf8TooLong | utf8Overlong2 | utf8TwoContinuations | utf8Surrogate | utf8TooLarge,
+        utf8TooLong | utf8Overlong2 | utf8TwoContinuations | utf8Surrogate | utf8TooLarge,
+        
+        // Leads
+        utf8TooShort, utf8TooShort, utf8TooShort, utf8TooShort
+    };
+    
+    //! The largest values for the last bytes of a block, that don't start a sequence continuing past it
+    /*! The vectorized versions load the last 16, 32 or 64 bytes */
+    extern const std::uint8_t utf8IncompleteMaximum[64] =
+    {
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1
+    };
+    
+    // Implemented in simd_sse42.cpp, simd_avx2.cpp and simd_avx512.cpp, which are compiled
+    // with the flags for their instruction set. Only call them after checking the host.
+    
+    const char* findStringSpecialSse42(const char* begin, const char* end);
+    const char* skipWhitespaceSse42(const char* begin, const char* end);
+    bool validateUtf8Sse42(const char* begin, const char* end);
+    
+    const char* findStringSpecialAvx2(const char* begin, const char* end);
+    const char* skipWhitespaceAvx2(const char* begin, const char* end);
+    bool validateUtf8Avx2(const char* begin, const char* end);
+    
+    const char* findStringSpecialAvx512(const char* begin, const char* end);
+    const char* skipWhitespaceAvx512(const char* begin, const char* end);
+    bool validateUtf8Avx512(const char* begin, const char* end);
+    
+    static constexpr Kernels sse42Kernels = { SimdLevel::SSE42, findStringSpecialSse42, skipWhitespaceSse42, validateUtf8Sse42 };
+    static constexpr Kernels avx2Kernels = { SimdLevel::AVX2, findStringSpecialAvx2, skipWhitespaceAvx2, validateUtf8Avx2 };
+    static constexpr Kernels avx512Kernels = { SimdLevel::AVX512, findStringSpecialAvx512, skipWhitespaceAvx512, validateUtf8Avx512 };
+    
+    static void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int (&registers)[4])
+    {
+#ifdef _MSC_VER
+        int values[4];
+        __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+        for (auto i = 0; i < 4; ++i)
+            registers[i] = static_cast<unsigned int>(values[i]);
+#else
+        if (!__get_cpuid_count(leaf, subleaf, &registers[0], &registers[1], &registers[2], &registers[3]))
+            registers[0] = registers[1] = registers[2] = registers[3] = 0;
+#endif
+    }
+    
+    //! Which register states the OS saves on context switches
+    static std::uint64_t getExtendedControlRegister()
+    {
+#ifdef _MSC_VER
+        return _xgetbv(0);
+#else
+        unsigned int low = 0;
+        unsigned int high = 0;
+        __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+        return (static_cast<std::uint64_t>(high) << 32) | low;
+#endif
+    }
+    
+    static SimdLevel detectSimdLevel()
+    {
+        unsigned int registers[4];
+        cpuid(0, 0, registers);
+        const auto maximumLeaf = registers[0];
+        
+        cpuid(1, 0, registers);
+        const auto sse42 = (registers[2] & (1u << 20)) != 0;
+        const auto osxsave = (registers[2] & (1u << 27)) != 0;
+        const auto avx = (registers[2] & (1u << 28)) != 0;
+        
+        if (!sse42)
+            return SimdLevel::SCALAR;
+        
+        // The wider registers are only usable if the OS preserves them
+        if (!osxsave || !avx || maximumLeaf < 7)
+            return SimdLevel::SSE42;
+        
+        const auto xcr0 = getExtendedControlRegister();
+        if ((xcr0 & 0x6) != 0x6)
+            return SimdLevel::SSE42;
+        
+        cpuid(7, 0, registers);
+        const auto avx2 = (registers[1] & (1u << 5)) != 0;
+        const auto avx512f = (registers[1] & (1u << 16)) != 0;
+        const auto avx512bw = (registers[1] & (1u << 30)) != 0;
+        
+        if (!avx2)
+            return SimdLevel::SSE42;
+        
+        if (avx512f && avx512bw && (xcr0 & 0xE6) == 0xE6)
+            return SimdLevel::AVX512;
+        
+        return SimdLevel::AVX2;
+    }
+
+#else
+    
+    static SimdLevel detectSimdLevel()
+    {
+        return SimdLevel::SCALAR;
+    }
+
+#endif
+    
+    static const Kernels& getKernels(SimdLevel level)
+    {
+        switch (level)
+        {
+#if JSON_SIMD_X86
+            case SimdLevel::AVX512: return avx512Kernels;
+            case SimdLevel::AVX2: return avx2Kernels;
+            case SimdLevel::SSE42: return sse42Kernels;
+#endif
+            default: return scalarKernels;
+        }
+    }
+    
+    //! Select the kernels on first use, taking JSONATA_SIMD into account
+    static const Kernels& selectKernels()
+    {
+        auto level = getSupportedSimdLevel();
+        
+        if (const auto* variable = std::getenv("JSONATA_SIMD"))
+        {
+            if (std::strcmp(variable, "scalar") == 0)
+                level = SimdLevel::SCALAR;
+            else if (std::strcmp(variable, "sse4.2") == 0 && level > SimdLevel::SSE42)
+                level = SimdLevel::SSE42;
+            else if (std::strcmp(variable, "avx2") == 0 && level > SimdLevel::AVX2)
+                level = SimdLevel::AVX2;
+        }
+        
+        return getKernels(level);
+    }
+    
+    static const char* findStringSpecialResolving(const char* begin, const char* end);
+    static const char* skipWhitespaceResolving(const char* begin, const char* end);
+    static bool validateUtf8Resolving(const char* begin, const char* end);
+    
+    //! Stands in until the first call, which selects the real kernels
+    static constexpr Kernels resolvingKernels = { SimdLevel::SCALAR, findStringSpecialResolving, skipWhitespaceResolving, validateUtf8Resolving };
+    
+    //! The kernels that are currently in use
+    static std::atomic<const Kernels*> activeKernels{&resolvingKernels};
+    
+    static const Kernels& getActiveKernels()
+    {
+        const auto* kernels = activeKernels.load(std::memory_order_relaxed);
+        if (kernels != &resolvingKernels)
+            return *kernels;
+        
+        // Multiple threads may race to get here, but they'll all select the same kernels
+        kernels = &selectKernels();
+        activeKernels.store(kernels, std::memory_order_relaxed);
+        return *kernels;
+    }
+    
+    static const char* findStringSpecialResolving(const char* begin, const char* end)
+    {
+        return getActiveKernels().findStringSpecial(begin, end);
+    }
+    
+    static const char* skipWhitespaceResolving(const char* begin, const char* end)
+    {
+        return getActiveKernels().skipWhitespace(begin, end);
+    }
+    
+    static bool validateUtf8Resolving(const char* begin, const char* end)
+    {
+        return getActiveKernels().validateUtf8(begin, end);
+    }
+    
+    SimdLevel getSupportedSimdLevel()
+    {
+        static const auto level = detectSimdLevel();
+        return level;
+    }
+    
+    SimdLevel getSimdLevel()
+    {
+        return getActiveKernels().level;
+    }
+    
+    void setSimdLevel(SimdLevel level)
+    {
+        if (level > getSupportedSimdLevel())
+            level = getSupportedSimdLevel();
+        
+        activeKernels.store(&getKernels(level), std::memory_order_relaxed);
+    }
+    
+    const char* findStringSpecial(const char* begin, const char* end)
+    {
+        return activeKernels.load(std::memory_order_relaxed)->findStringSpecial(begin, end);
+    }
+    
+    const char* skipWhitespace(const char* begin, const char* end)
+    {
+        return activeKernels.load(std::memory_order_relaxed)->skipWhitespace(begin, end);
+    }
+    
+    bool validateUtf8(const char* begin, const char* end)
+    {
+        return activeKernels.load(std::memory_order_relaxed)->validateUtf8(begin, end);
+    }
+}
@@ -0,0 +1,57 @@
+//
+//  simd.hpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#ifndef JSON_SIMD_HPP
+#define JSON_SIMD_HPP
+
+namespace json
+{
+    //! The instruction sets the vectorized routines can be implemented with
+    enum class SimdLevel
+    {
+        SCALAR,
+        SSE42,
+        AVX2,
+        AVX512
+    };
+    
+    //! Return the most capable level that both the host and this build support
+    SimdLevel getSupportedSimdLevel();
+    
+    //! Return the level the vectorized routines currently use
+    /*! By default this is getSupportedSimdLevel(), unless the JSONATA_SIMD environment variable
+        is set to "scalar", "sse4.2", "avx2" or "avx512" at startup. */
+    SimdLevel getSimdLevel();
+    
+    //! Force the vectorized routines to use a certain level, e.g. for benchmarking
+    /*! Levels the host doesn't support are clamped to getSupportedSimdLevel().
+        @warning Not meant to be called while other threads are parsing or writing */
+    void setSimdLevel(SimdLevel level);
+    
+    //! Find the first quote, backslash or control character in a range
+    /*! These are the bytes that end a run of plain string content, and that need escaping when written.
+        @return end if there is no such byte */
+    const char* findStringSpecial(const char* begin, const char* end);
+    
+    //! Find the first byte in a range that isn't whitespace
+    /*! @return end if the range consists only of whitespace */
+    const char* skipWhitespace(const char* begin, const char* end);
+    
+    //! Is a range of bytes valid UTF-8?
+    /*! Rejects overlong encodings, surrogates, code points above U+10FFFF and truncated sequences */
+    bool validateUtf8(const char* begin, const char* end);
+    
+    //! Is a byte whitespace?
+    /*! Matches ::isspace() in the "C" locale */
+    constexpr bool isWhitespace(char c)
+    {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+}
+
+#endif
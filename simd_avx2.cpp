@@ -0,0 +1,152 @@
+//
+//  simd_avx2.cpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+// Compiled with AVX2 enabled, see CMakeLists.txt. Only called after checking the host supports it.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace json
+{
+    const char* findStringSpecialScalar(const char* begin, const char* end);
+    const char* skipWhitespaceScalar(const char* begin, const char* end);
+    
+    extern const std::uint8_t utf8PreviousHighNibble[16];
+    extern const std::uint8_t utf8PreviousLowNibble[16];
+    extern const std::uint8_t utf8CurrentHighNibble[16];
+    extern const std::uint8_t utf8IncompleteMaximum[64];
+    
+    static inline unsigned int countTrailingZeros(std::uint32_t mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index = 0;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned int>(index);
+#else
+        return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+    }
+    
+    const char* findStringSpecialAvx2(const char* begin, const char* end)
+    {
+        const auto quote = _mm256_set1_epi8('"');
+        const auto backslash = _mm256_set1_epi8('\\');
+        const auto control = _mm256_set1_epi8(0x1F);
+        
+        for (; end - begin >= 32; begin += 32)
+        {
+            const auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+            const auto special = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, quote), _mm256_cmpeq_epi8(bytes, backslash)),
+                                                 _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, control), bytes));
+            
+            if (const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(special)); mask != 0)
+                return begin + countTrailingZeros(mask);
+        }
+        
+        return findStringSpecialScalar(begin, end);
+    }
+    
+    const char* skipWhitespaceAvx2(const char* begin, const char* end)
+    {
+        const auto space = _mm256_set1_epi8(' ');
+        const auto tab = _mm256_set1_epi8('\t');
+        const auto range = _mm256_set1_epi8('\r' - '\t');
+        
+        for (; end - begin >= 32; begin += 32)
+        {
+            // Whitespace is a space, or any of the characters between \t and \r
+            const auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+            const auto offset = _mm256_sub_epi8(bytes, tab);
+            const auto whitespace = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, space),
+                                                    _mm256_cmpeq_epi8(_mm256_min_epu8(offset, range), offset));
+            
+            if (const auto mask = ~static_cast<std::uint32_t>(_mm256_movemask_epi8(whitespace)); mask != 0)
+                return begin + countTrailingZeros(mask);
+        }
+        
+        return skipWhitespaceScalar(begin, end);
+    }
+    
+    //! Load one of the UTF-8 lookup tables into both lanes, as shuffles don't cross them
+    static inline __m256i loadLookupTable(const std::uint8_t (&table)[16])
+    {
+        return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table)));
+    }
+    
+    bool validateUtf8Avx2(const char* begin, const char* end)
+    {
+        // See simd.cpp for how the lookup tables work
+        const auto previousHighNibble = loadLookupTable(utf8PreviousHighNibble);
+        const auto previousLowNibble = loadLookupTable(utf8PreviousLowNibble);
+        const auto currentHighNibble = loadLookupTable(utf8CurrentHighNibble);
+        const auto incompleteMaximum = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(utf8IncompleteMaximum + 32));
+        const auto lowNibble = _mm256_set1_epi8(0x0F);
+        const auto thirdByte = _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80));
+        const auto fourthByte = _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80));
+        const auto highBit = _mm256_set1_epi8(static_cast<char>(0x80));
+        
+        auto error = _mm256_setzero_si256();
+        auto previous = _mm256_setzero_si256();
+        auto previousIncomplete = _mm256_setzero_si256();
+        
+        const auto validate = [&](__m256i bytes)
+        {
+            // A block of ASCII is valid, as long as the block before it didn't end halfway a sequence
+            if (_mm256_movemask_epi8(bytes) == 0)
+            {
+                error = _mm256_or_si256(error, previousIncomplete);
+                previousIncomplete = _mm256_setzero_si256();
+            }
+            else
+            {
+                // Byte shifts work per lane, so pair each lane with the one that precedes it
+                const auto preceding = _mm256_permute2x128_si256(previous, bytes, 0x21);
+                const auto previous1 = _mm256_alignr_epi8(bytes, preceding, 15);
+                const auto previous2 = _mm256_alignr_epi8(bytes, preceding, 14);
+                const auto previous3 = _mm256_alignr_epi8(bytes, preceding, 13);
+                
+                const auto special = _mm256_and_si256(_mm256_and_si256(
+                    _mm256_shuffle_epi8(previousHighNibble, _mm256_and_si256(_mm256_srli_epi16(previous1, 4), lowNibble)),
+                    _mm256_shuffle_epi8(previousLowNibble, _mm256_and_si256(previous1, lowNibble))),
+                    _mm256_shuffle_epi8(currentHighNibble, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), lowNibble)));
+                
+                // The high bit is set for bytes that have to be the third or fourth of a sequence
+                const auto continuation = _mm256_and_si256(_mm256_or_si256(_mm256_subs_epu8(previous2, thirdByte),
+                                                                           _mm256_subs_epu8(previous3, fourthByte)), highBit);
+                
+                error = _mm256_or_si256(error, _mm256_xor_si256(special, continuation));
+                previousIncomplete = _mm256_subs_epu8(bytes, incompleteMaximum);
+            }
+            
+            previous = bytes;
+        };
+        
+        for (; end - begin >= 32; begin += 32)
+            validate(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin)));
+        
+        // Pad the remaining bytes with ASCII, which also catches sequences that are cut off by the end
+        if (begin != end)
+        {
+            char block[32] = {};
+            std::memcpy(block, begin, static_cast<std::size_t>(end - begin));
+            validate(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block)));
+        }
+        
+        error = _mm256_or_si256(error, previousIncomplete);
+        return _mm256_testz_si256(error, error) != 0;
+    }
+}
+
+#endif
@@ -0,0 +1,165 @@
+//
+//  simd_avx512.cpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+// Compiled with AVX-512 (F and BW) enabled, see CMakeLists.txt. Only called after checking the host supports it.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace json
+{
+    const char* findStringSpecialScalar(const char* begin, const char* end);
+    const char* skipWhitespaceScalar(const char* begin, const char* end);
+    
+    extern const std::uint8_t utf8PreviousHighNibble[16];
+    extern const std::uint8_t utf8PreviousLowNibble[16];
+    extern const std::uint8_t utf8CurrentHighNibble[16];
+    extern const std::uint8_t utf8IncompleteMaximum[64];
+    
+    static inline unsigned int countTrailingZeros(std::uint64_t mask)
+    {
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index = 0;
+        _BitScanForward64(&index, mask);
+        return static_cast<unsigned int>(index);
+#elif defined(_MSC_VER)
+        unsigned long index = 0;
+        if (_BitScanForward(&index, static_cast<unsigned long>(mask)))
+            return static_cast<unsigned int>(index);
+        
+        _BitScanForward(&index, static_cast<unsigned long>(mask >> 32));
+        return static_cast<unsigned int>(index) + 32;
+#else
+        return static_cast<unsigned int>(__builtin_ctzll(mask));
+#endif
+    }
+    
+    const char* findStringSpecialAvx512(const char* begin, const char* end)
+    {
+        const auto quote = _mm512_set1_epi8('"');
+        const auto backslash = _mm512_set1_epi8('\\');
+        const auto control = _mm512_set1_epi8(0x1F);
+        
+        for (; end - begin >= 64; begin += 64)
+        {
+            const auto bytes = _mm512_loadu_si512(begin);
+            const auto mask = _mm512_cmpeq_epi8_mask(bytes, quote) | _mm512_cmpeq_epi8_mask(bytes, backslash) | _mm512_cmple_epu8_mask(bytes, control);
+            
+            if (mask != 0)
+                return begin + countTrailingZeros(mask);
+        }
+        
+        return findStringSpecialScalar(begin, end);
+    }
+    
+    const char* skipWhitespaceAvx512(const char* begin, const char* end)
+    {
+        const auto space = _mm512_set1_epi8(' ');
+        const auto tab = _mm512_set1_epi8('\t');
+        const auto range = _mm512_set1_epi8('\r' - '\t');
+        
+        for (; end - begin >= 64; begin += 64)
+        {
+            // Whitespace is a space, or any of the characters between \t and \r
+            const auto bytes = _mm512_loadu_si512(begin);
+            const auto whitespace = _mm512_cmpeq_epi8_mask(bytes, space) | _mm512_cmple_epu8_mask(_mm512_sub_epi8(bytes, tab), range);
+            
+            if (const auto mask = ~static_cast<std::uint64_t>(whitespace); mask != 0)
+                return begin + countTrailingZeros(mask);
+        }
+        
+        return skipWhitespaceScalar(begin, end);
+    }
+    
+    //! Load one of the UTF-8 lookup tables into all lanes, as shuffles don't cross them
+    /*! The table is replicated in memory rather than with _mm512_broadcast_i32x4(), whose definition in
+        GCC's headers trips -Wuninitialized in optimized builds */
+    static inline __m512i loadLookupTable(const std::uint8_t (&table)[16])
+    {
+        std::uint8_t replicated[64];
+        for (std::size_t lane = 0; lane < 4; ++lane)
+            std::memcpy(replicated + lane * 16, table, 16);
+        
+        return _mm512_loadu_si512(replicated);
+    }
+    
+    bool validateUtf8Avx512(const char* begin, const char* end)
+    {
+        // See simd.cpp for how the lookup tables work
+        const auto previousHighNibble = loadLookupTable(utf8PreviousHighNibble);
+        const auto previousLowNibble = loadLookupTable(utf8PreviousLowNibble);
+        const auto currentHighNibble = loadLookupTable(utf8CurrentHighNibble);
+        const auto incompleteMaximum = _mm512_loadu_si512(utf8IncompleteMaximum);
+        const auto lowNibble = _mm512_set1_epi8(0x0F);
+        const auto thirdByte = _mm512_set1_epi8(static_cast<char>(0xE0 - 0x80));
+        const auto fourthByte = _mm512_set1_epi8(static_cast<char>(0xF0 - 0x80));
+        const auto highBit = _mm512_set1_epi8(static_cast<char>(0x80));
+        
+        // Selects the last lane of the previous block, followed by the first three of the current one
+        const auto precedingLanes = _mm512_setr_epi32(12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27);
+        
+        auto error = _mm512_setzero_si512();
+        auto previous = _mm512_setzero_si512();
+        auto previousIncomplete = _mm512_setzero_si512();
+        
+        const auto validate = [&](__m512i bytes)
+        {
+            // A block of ASCII is valid, as long as the block before it didn't end halfway a sequence
+            if (_mm512_movepi8_mask(bytes) == 0)
+            {
+                error = _mm512_or_si512(error, previousIncomplete);
+                previousIncomplete = _mm512_setzero_si512();
+            }
+            else
+            {
+                // Byte shifts work per lane, so pair each lane with the one that precedes it
+                const auto preceding = _mm512_permutex2var_epi32(previous, precedingLanes, bytes);
+                const auto previous1 = _mm512_alignr_epi8(bytes, preceding, 15);
+                const auto previous2 = _mm512_alignr_epi8(bytes, preceding, 14);
+                const auto previous3 = _mm512_alignr_epi8(bytes, preceding, 13);
+                
+                const auto special = _mm512_and_si512(_mm512_and_si512(
+                    _mm512_shuffle_epi8(previousHighNibble, _mm512_and_si512(_mm512_srli_epi16(previous1, 4), lowNibble)),
+                    _mm512_shuffle_epi8(previousLowNibble, _mm512_and_si512(previous1, lowNibble))),
+                    _mm512_shuffle_epi8(currentHighNibble, _mm512_and_si512(_mm512_srli_epi16(bytes, 4), lowNibble)));
+                
+                // The high bit is set for bytes that have to be the third or fourth of a sequence
+                const auto continuation = _mm512_and_si512(_mm512_or_si512(_mm512_subs_epu8(previous2, thirdByte),
+                                                                           _mm512_subs_epu8(previous3, fourthByte)), highBit);
+                
+                error = _mm512_or_si512(error, _mm512_xor_si512(special, continuation));
+                previousIncomplete = _mm512_subs_epu8(bytes, incompleteMaximum);
+            }
+            
+            previous = bytes;
+        };
+        
+        for (; end - begin >= 64; begin += 64)
+            validate(_mm512_loadu_si512(begin));
+        
+        // Pad the remaining bytes with ASCII, which also catches sequences that are cut off by the end
+        if (begin != end)
+        {
+            char block[64] = {};
+            std::memcpy(block, begin, static_cast<std::size_t>(end - begin));
+            validate(_mm512_loadu_si512(block));
+        }
+        
+        error = _mm512_or_si512(error, previousIncomplete);
+        return _mm512_test_epi8_mask(error, error) == 0;
+    }
+}
+
+#endif
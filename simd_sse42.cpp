@@ -0,0 +1,144 @@
+//
+//  simd_sse42.cpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+// Compiled with SSE4.2 enabled, see CMakeLists.txt. Only called after checking the host supports it.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+
+#include <cstdint>
+#include <cstring>
+#include <nmmintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace json
+{
+    const char* findStringSpecialScalar(const char* begin, const char* end);
+    const char* skipWhitespaceScalar(const char* begin, const char* end);
+    
+    extern const std::uint8_t utf8PreviousHighNibble[16];
+    extern const std::uint8_t utf8PreviousLowNibble[16];
+    extern const std::uint8_t utf8CurrentHighNibble[16];
+    extern const std::uint8_t utf8IncompleteMaximum[64];
+    
+    static inline unsigned int countTrailingZeros(std::uint32_t mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index = 0;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned int>(index);
+#else
+        return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+    }
+    
+    const char* findStringSpecialSse42(const char* begin, const char* end)
+    {
+        const auto quote = _mm_set1_epi8('"');
+        const auto backslash = _mm_set1_epi8('\\');
+        const auto control = _mm_set1_epi8(0x1F);
+        
+        for (; end - begin >= 16; begin += 16)
+        {
+            const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+            const auto special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, quote), _mm_cmpeq_epi8(bytes, backslash)),
+                                              _mm_cmpeq_epi8(_mm_min_epu8(bytes, control), bytes));
+            
+            if (const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(special)); mask != 0)
+                return begin + countTrailingZeros(mask);
+        }
+        
+        return findStringSpecialScalar(begin, end);
+    }
+    
+    const char* skipWhitespaceSse42(const char* begin, const char* end)
+    {
+        const auto space = _mm_set1_epi8(' ');
+        const auto tab = _mm_set1_epi8('\t');
+        const auto range = _mm_set1_epi8('\r' - '\t');
+        
+        for (; end - begin >= 16; begin += 16)
+        {
+            // Whitespace is a space, or any of the characters between \t and \r
+            const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+            const auto offset = _mm_sub_epi8(bytes, tab);
+            const auto whitespace = _mm_or_si128(_mm_cmpeq_epi8(bytes, space),
+                                                 _mm_cmpeq_epi8(_mm_min_epu8(offset, range), offset));
+            
+            if (const auto mask = ~static_cast<std::uint32_t>(_mm_movemask_epi8(whitespace)) & 0xFFFF; mask != 0)
+                return begin + countTrailingZeros(mask);
+        }
+        
+        return skipWhitespaceScalar(begin, end);
+    }
+    
+    bool validateUtf8Sse42(const char* begin, const char* end)
+    {
+        // See simd.cpp for how the lookup tables work
+        const auto previousHighNibble = _mm_loadu_si128(reinterpret_cast<const __m128i*>(utf8PreviousHighNibble));
+        const auto previousLowNibble = _mm_loadu_si128(reinterpret_cast<const __m128i*>(utf8PreviousLowNibble));
+        const auto currentHighNibble = _mm_loadu_si128(reinterpret_cast<const __m128i*>(utf8CurrentHighNibble));
+        const auto incompleteMaximum = _mm_loadu_si128(reinterpret_cast<const __m128i*>(utf8IncompleteMaximum + 48));
+        const auto lowNibble = _mm_set1_epi8(0x0F);
+        const auto thirdByte = _mm_set1_epi8(static_cast<char>(0xE0 - 0x80));
+        const auto fourthByte = _mm_set1_epi8(static_cast<char>(0xF0 - 0x80));
+        const auto highBit = _mm_set1_epi8(static_cast<char>(0x80));
+        
+        auto error = _mm_setzero_si128();
+        auto previous = _mm_setzero_si128();
+        auto previousIncomplete = _mm_setzero_si128();
+        
+        const auto validate = [&](__m128i bytes)
+        {
+            // A block of ASCII is valid, as long as the block before it didn't end halfway a sequence
+            if (_mm_movemask_epi8(bytes) == 0)
+            {
+                error = _mm_or_si128(error, previousIncomplete);
+                previousIncomplete = _mm_setzero_si128();
+            }
+            else
+            {
+                const auto previous1 = _mm_alignr_epi8(bytes, previous, 15);
+                const auto previous2 = _mm_alignr_epi8(bytes, previous, 14);
+                const auto previous3 = _mm_alignr_epi8(bytes, previous, 13);
+                
+                const auto special = _mm_and_si128(_mm_and_si128(
+                    _mm_shuffle_epi8(previousHighNibble, _mm_and_si128(_mm_srli_epi16(previous1, 4), lowNibble)),
+                    _mm_shuffle_epi8(previousLowNibble, _mm_and_si128(previous1, lowNibble))),
+                    _mm_shuffle_epi8(currentHighNibble, _mm_and_si128(_mm_srli_epi16(bytes, 4), lowNibble)));
+                
+                // The high bit is set for bytes that have to be the third or fourth of a sequence
+                const auto continuation = _mm_and_si128(_mm_or_si128(_mm_subs_epu8(previous2, thirdByte),
+                                                                     _mm_subs_epu8(previous3, fourthByte)), highBit);
+                
+                error = _mm_or_si128(error, _mm_xor_si128(special, continuation));
+                previousIncomplete = _mm_subs_epu8(bytes, incompleteMaximum);
+            }
+            
+            previous = bytes;
+        };
+        
+        for (; end - begin >= 16; begin += 16)
+            validate(_mm_loadu_si128(reinterpret_cast<const __m128i*>(begin)));
+        
+        // Pad the remaining bytes with ASCII, which also catches sequences that are cut off by the end
+        if (begin != end)
+        {
+            char block[16] = {};
+            std::memcpy(block, begin, static_cast<std::size_t>(end - begin));
+            validate(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block)));
+        }
+        
+        error = _mm_or_si128(error, previousIncomplete);
+        return _mm_testz_si128(error, error) != 0;
+    }
+}
+
+#endif
@@ -0,0 +1,698 @@
+//
+//  tests.cpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+// Regression tests, run through ctest. Every check compares a faster or more incremental path
+// against the plain one-shot parse() of the same input, using pseudo-random inputs with a fixed seed.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <locale>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <unistd.h>
+#endif
+
+#include "json.hpp"
+
+using namespace std;
+
+namespace
+{
+    //! While non-zero, allocations of at least this many bytes fail, to make parsing threads throw
+    atomic<size_t> failingAllocationSize{0};
+}
+
+void* operator new(size_t size)
+{
+    if (const auto failing = failingAllocationSize.load(); failing != 0 && size >= failing)
+        throw bad_alloc();
+    
+    if (auto* memory = malloc(size != 0 ? size : 1))
+        return memory;
+    
+    throw bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+
+namespace
+{
+    //! The number of checks that failed so far
+    size_t failures = 0;
+    
+    //! Generates the inputs, the same ones on every run
+    mt19937_64 generator(2016);
+    
+    //! Report a check that failed
+    void check(bool condition, const string& what)
+    {
+        if (condition)
+            return;
+        
+        ++failures;
+        cerr << "FAILED: " << what << endl;
+    }
+    
+    //! Return a random number in [0, count)
+    size_t pick(size_t count)
+    {
+        return static_cast<size_t>(generator() % count);
+    }
+    
+    //! Generate whitespace and comments, or nothing
+    string generateGap()
+    {
+        switch (pick(10))
+        {
+            case 0: return " ";
+            case 1: return "\n\t";
+            case 2: return "/* \"]} */";
+            case 3: return "# \"]\n";
+            case 4: return "// \\\" [\n";
+            case 5: return "/*" + string(pick(300), '*') + "*/";
+            default: return "";
+        }
+    }
+    
+    //! Generate the contents of a string, including escape sequences and multi-byte characters
+    string generateStringContents()
+    {
+        static const char* pieces[] = { "a", "text", "\\\"", "\\\\", "\\n", "\\u00e9", "\\ud83d\\ude00", "\xc3\xa9", "\xe2\x82\xac", "{]:,", " " };
+        
+        string contents;
+        const auto count = pick(4) == 0 ? pick(200) : pick(8);
+        for (size_t i = 0; i < count; ++i)
+            contents += pieces[pick(sizeof(pieces) / sizeof(pieces[0]))];
+        
+        return contents;
+    }
+    
+    //! Generate a Json value, nesting arrays and objects up to some depth
+    string generateValue(size_t depth = 0)
+    {
+        auto text = generateGap();
+        switch (pick(depth > 4 ? 5 : 7))
+        {
+            case 0: text += "null"; break;
+            case 1: text += pick(2) ? "true" : "false"; break;
+            case 2: text += to_string(static_cast<int64_t>(generator() >> pick(64))) + string(pick(4) == 0 ? pick(40) : 0, '7'); break;
+            case 3: text += "-" + to_string(pick(1000)) + ".25e" + to_string(pick(20)); break;
+            case 4: text += "\"" + generateStringContents() + "\""; break;
+            case 5:
+            {
+                text += "[";
+                for (size_t i = 0, count = pick(5); i < count; ++i)
+                    text += (i ? "," : "") + generateValue(depth + 1);
+                
+                text += generateGap() + "]";
+                break;
+            }
+            default:
+            {
+                text += "{";
+                for (size_t i = 0, count = pick(5); i < count; ++i)
+                    text += (i ? "," : "") + generateGap() + "\"key" + to_string(pick(4)) + "\"" + generateGap() + ":" + generateValue(depth + 1);
+                
+                text += generateGap() + "}";
+                break;
+            }
+        }
+        
+        return text + generateGap();
+    }
+    
+    //! Break some of the generated inputs, so that errors are compared as well
+    void mutate(string& text)
+    {
+        static const char replacements[] = "\"\\{}[]:, a1/#\nte";
+        
+        for (size_t i = 0, count = pick(4); i < count && !text.empty(); ++i)
+        {
+            const auto position = pick(text.size());
+            const auto replacement = replacements[pick(sizeof(replacements) - 1)];
+            
+            switch (pick(3))
+            {
+                case 0: text[position] = replacement; break;
+                case 1: text.erase(position, 1); break;
+                default: text.insert(position, 1, replacement); break;
+            }
+        }
+    }
+    
+    //! The outcome of parsing some input, either a value or an error
+    struct Outcome
+    {
+        json::Value value;
+        json::ErrorCode error = json::ErrorCode::NONE;
+        size_t line = 0;
+        size_t character = 0;
+        
+        bool operator==(const Outcome& rhs) const
+        {
+            return error == rhs.error && line == rhs.line && character == rhs.character && value == rhs.value;
+        }
+    };
+    
+    Outcome parseAtOnce(string_view text, const json::ParseOptions& options)
+    {
+        Outcome outcome;
+        auto result = json::tryParse(text, options);
+        outcome.value = std::move(result.value);
+        outcome.error = result.error.code;
+        outcome.line = result.error.line;
+        outcome.character = result.error.character;
+        return outcome;
+    }
+    
+    //! Feed text to a PushParser, in chunks that end at the given offsets
+    Outcome parseInChunks(string_view text, const vector<size_t>& cuts, const json::ParseOptions& options)
+    {
+        Outcome outcome;
+        try
+        {
+            json::PushParser parser(options);
+            
+            auto complete = false;
+            size_t begin = 0;
+            for (auto cut = cuts.begin(); !complete && cut != cuts.end(); ++cut)
+            {
+                complete = parser.feed(text.substr(begin, *cut - begin));
+                begin = *cut;
+            }
+            
+            if (!complete)
+                complete = parser.feed(text.substr(begin));
+            
+            if (complete || parser.finish())
+                outcome.value = parser.takeValue();
+        } catch (json::Error& error) {
+            outcome.error = error.getCode();
+            outcome.line = error.getLine();
+            outcome.character = error.getCharacter();
+        }
+        
+        return outcome;
+    }
+    
+    //! Validate UTF-8 one code point at a time, as a reference for the vectorized validators
+    bool isValidUtf8(string_view text)
+    {
+        for (size_t i = 0; i < text.size();)
+        {
+            const auto lead = static_cast<unsigned char>(text[i]);
+            size_t length = 0;
+            uint32_t codePoint = 0;
+            
+            if (lead < 0x80)
+                length = 1, codePoint = lead;
+            else if (lead >= 0xC2 && lead <= 0xDF)
+                length = 2, codePoint = lead & 0x1Fu;
+            else if (lead >= 0xE0 && lead <= 0xEF)
+                length = 3, codePoint = lead & 0x0Fu;
+            else if (lead >= 0xF0 && lead <= 0xF4)
+                length = 4, codePoint = lead & 0x07u;
+            else
+                return false;
+            
+            if (i + length > text.size())
+                return false;
+            
+            for (size_t j = 1; j < length; ++j)
+            {
+                const auto continuation = static_cast<unsigned char>(text[i + j]);
+                if ((continuation & 0xC0) != 0x80)
+                    return false;
+                
+                codePoint = (codePoint << 6) | (continuation & 0x3Fu);
+            }
+            
+            // Reject overlong encodings, surrogates and code points beyond Unicode
+            if ((length == 3 && codePoint < 0x800) || (length == 4 && codePoint < 0x10000) ||
+                (codePoint >= 0xD800 && codePoint <= 0xDFFF) || codePoint > 0x10FFFF)
+                return false;
+            
+            i += length;
+        }
+        
+        return true;
+    }
+    
+    //! Generate string contents that are mostly valid UTF-8, without quotes, backslashes or control characters
+    string generateUtf8()
+    {
+        static const char* pieces[] = { "a", "0123456789abcdef", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "\xf4\x8f\xbf\xbf", "\xed\x9f\xbf", "\xef\xbf\xbd" };
+        static const char* broken[] = { "\x80", "\xc0\xaf", "\xc3", "\xe0\x80\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xf8", "\xff", "\xe2\x82" };
+        
+        string text;
+        for (size_t count = pick(40); count > 0; --count)
+            text += pieces[pick(sizeof(pieces) / sizeof(pieces[0]))];
+        
+        if (pick(2))
+            text.insert(pick(text.size() + 1), broken[pick(sizeof(broken) / sizeof(broken[0]))]);
+        
+        // A sequence that is cut off right at the end of a vector is only caught after the last one
+        if (pick(4) == 0)
+        {
+            const string truncated = pick(2) ? "\xc3" : "\xf0\x9f\x98";
+            text.resize((text.size() / 64 + 1) * 64 - truncated.size(), 'a');
+            text += truncated;
+        }
+        
+        return text;
+    }
+    
+    //! Every level of the vectorized UTF-8 validator should agree with the reference, and parse() with both
+    void testUtf8Validation()
+    {
+        const auto supported = static_cast<int>(json::getSupportedSimdLevel());
+        
+        json::ParseOptions options;
+        options.validateUtf8 = true;
+        
+        for (size_t i = 0; i < 20000; ++i)
+        {
+            const auto text = generateUtf8();
+            const auto valid = isValidUtf8(text);
+            
+            for (auto level = 0; level <= supported; ++level)
+            {
+                json::setSimdLevel(static_cast<json::SimdLevel>(level));
+                check(json::validateUtf8(text.data(), text.data() + text.size()) == valid, "validateUtf8() at level " + to_string(level) + " is wrong for " + text);
+                
+                const auto result = json::tryParse("\"" + text + "\"", options);
+                check(static_cast<bool>(result) == valid, "parse() at level " + to_string(level) + " validates UTF-8 wrongly for " + text);
+                if (result)
+                    check(result.value.asString() == text, "parse() at level " + to_string(level) + " changed the string " + text);
+            }
+        }
+        
+        json::setSimdLevel(json::getSupportedSimdLevel());
+    }
+    
+    //! Nest arrays and objects in each other, alternately
+    string generateNesting(size_t depth)
+    {
+        string text;
+        for (size_t i = 0; i < depth; ++i)
+            text += i % 2 ? "{\"a\":" : "[";
+        
+        text += "0";
+        for (size_t i = depth; i > 0; --i)
+            text += (i - 1) % 2 ? "}" : "]";
+        
+        return text;
+    }
+    
+    //! Nesting should be limited by maxDepth, and anything that is allowed shouldn't overflow the stack
+    void testNesting()
+    {
+        for (size_t maxDepth : { 1, 2, 3, 64, 65, 1000 })
+        {
+            json::ParseOptions options;
+            options.maxDepth = maxDepth;
+            
+            check(static_cast<bool>(json::tryParse(generateNesting(maxDepth), options)), "parse() rejects nesting up to maxDepth " + to_string(maxDepth));
+            check(json::tryParse(generateNesting(maxDepth + 1), options).error.code == json::ErrorCode::TOO_DEEP, "parse() accepts nesting beyond maxDepth " + to_string(maxDepth));
+        }
+        
+        // Deep enough that recursing for each level would run out of stack
+        const auto text = generateNesting(300000);
+        
+        json::ParseOptions options;
+        options.maxDepth = 300000;
+        
+        const auto value = json::parse(text, options);
+        check(json::LeanWriter().writeToString(value) == text, "LeanWriter changes deeply nested values");
+        
+        auto copy = value;
+        check(copy == value, "copies of deeply nested values differ");
+        
+        // Changing the innermost number makes the comparison walk the whole copy to find it
+        auto* innermost = &copy;
+        for (size_t i = 0; i < 300000; ++i)
+            innermost = i % 2 ? &(*innermost)["a"] : &(*innermost)[0];
+        
+        *innermost = 1;
+        check(!(copy == value), "deeply nested values compare equal while they differ");
+    }
+    
+    //! An array that is small as text, but whose Value allocates more than failingAllocationSize
+    string generateLargeArray()
+    {
+        string text = "[0";
+        for (size_t i = 1; i < 100000; ++i)
+            text += ",0";
+        
+        return text + "]";
+    }
+    
+    //! Run a function with large allocations failing, and check that it throws std::bad_alloc
+    template <class Function>
+    void checkThrowsBadAlloc(Function function, const string& what)
+    {
+        auto thrown = false;
+        failingAllocationSize = 1024 * 1024;
+        
+        try
+        {
+            function();
+        } catch (const bad_alloc&) {
+            thrown = true;
+        }
+        
+        failingAllocationSize = 0;
+        check(thrown, what);
+    }
+    
+    //! An exception on one of the threads of parseLines() should be rethrown after the records before it
+    void testParseLinesRethrows()
+    {
+        const size_t failingRecord = 1234;
+        const auto generateLines = [&](bool failing)
+        {
+            string text;
+            for (size_t i = 0; i < 5000; ++i)
+                text += (failing && i == failingRecord ? generateLargeArray() : "{\"i\":" + to_string(i) + "}") + "\n";
+            
+            return text;
+        };
+        
+        const auto text = generateLines(true);
+        
+        json::ParseOptions options;
+        options.parallel.threadCount = 4;
+        options.parallel.chunkSize = 1024;
+        
+        for (auto ordered : { true, false })
+        {
+            options.parallel.ordered = ordered;
+            const auto mode = string(ordered ? "ordered" : "unordered");
+            
+            size_t records = 0;
+            checkThrowsBadAlloc([&] { json::parseLines(text, [&](json::Value&&) { ++records; }, options); }, "parseLines() swallows exceptions of its threads, " + mode);
+            if (ordered)
+                check(records == failingRecord, "parseLines() delivers " + to_string(records) + " records before an exception");
+            
+            istringstream stream(text);
+            checkThrowsBadAlloc([&] { json::parseLines(stream, [](json::Value&&) {}, options); }, "parseLines() swallows exceptions of its threads reading a stream, " + mode);
+        }
+        
+        // Without the large array, all records arrive
+        size_t records = 0;
+        json::parseLines(generateLines(false), [&](json::Value&&) { ++records; }, options);
+        check(records == 5000, "parseLines() delivers " + to_string(records) + " of 5000 records");
+        
+        // As they do from a stream, with the large array on a line that spans many chunks
+        istringstream stream(text);
+        records = 0;
+        json::parseLines(stream, [&](json::Value&&) { ++records; }, options);
+        check(records == 5000, "parseLines() delivers " + to_string(records) + " of 5000 records from a stream");
+    }
+    
+    //! Parsing the elements of an array on multiple threads should give the same as parsing it on one
+    void testParallelArray()
+    {
+        vector<string> elements;
+        for (size_t i = 0; i < 2000; ++i)
+            elements.push_back(generateValue(1));
+        
+        const auto join = [&]
+        {
+            string text = "[";
+            for (auto& element : elements)
+                text += (text.size() > 1 ? "," : "") + element;
+            
+            return text + "]";
+        };
+        
+        const auto text = join();
+        
+        json::ParseOptions sequential;
+        sequential.parallel.arrayThreshold = 0;
+        
+        json::ParseOptions parallel;
+        parallel.parallel.threadCount = 4;
+        parallel.parallel.chunkSize = 1024;
+        parallel.parallel.arrayThreshold = 1;
+        
+        check(parseAtOnce(text, parallel) == parseAtOnce(text, sequential), "parsing an array in parallel differs from parsing it sequentially");
+        
+        // Errors in any of the elements are reported the same way too
+        for (size_t i = 0; i < 50; ++i)
+        {
+            auto broken = text;
+            mutate(broken);
+            check(parseAtOnce(broken, parallel) == parseAtOnce(broken, sequential), "parsing an array in parallel differs from parsing it sequentially for " + broken);
+        }
+        
+        // An exception on one of the threads is rethrown on the calling one
+        elements.insert(elements.begin() + 1000, generateLargeArray());
+        const auto failing = join();
+        checkThrowsBadAlloc([&] { json::parse(failing, parallel); }, "parsing an array in parallel swallows exceptions of its threads");
+    }
+    
+    //! Parsing a file should give the same as parsing its contents, be it mapped or read
+    void testParseFile()
+    {
+        string text = "[";
+        while (text.size() < 200 * 1024)
+            text += (text.size() > 1 ? "," : "") + generateValue(1);
+        
+        text += "]";
+        
+        const auto expected = parseAtOnce(text, {});
+        const auto outcomeOf = [](const json::ParseResult& result)
+        {
+            Outcome outcome;
+            outcome.value = result.value;
+            outcome.error = result.error.code;
+            outcome.line = result.error.line;
+            outcome.character = result.error.character;
+            return outcome;
+        };
+        
+        const auto path = (filesystem::temp_directory_path() / ("jsonata-tests-" + to_string(generator()) + ".json")).string();
+        for (const auto& contents : { text, string() })
+        {
+            ofstream(path, ios::binary) << contents;
+            check(outcomeOf(json::tryParseFile(path)) == parseAtOnce(contents, {}), "parseFile() differs from parse() for a regular file of " + to_string(contents.size()) + " bytes");
+        }
+        
+        filesystem::remove(path);
+        
+        auto thrown = false;
+        try
+        {
+            json::parseFile(path);
+        } catch (const system_error&) {
+            thrown = true;
+        }
+        
+        check(thrown, "parseFile() doesn't throw std::system_error for a missing file");
+
+#if defined(__unix__) || defined(__APPLE__)
+        // Pipes can't be mapped, so they're read until they end, in chunks of less than the text
+        ::signal(SIGPIPE, SIG_IGN);
+        
+        int descriptors[2];
+        if (::pipe(descriptors) != 0)
+        {
+            check(false, "couldn't open a pipe to test parseFile() with");
+            return;
+        }
+        
+        thread writer([&]
+        {
+            for (size_t written = 0; written < text.size();)
+            {
+                const auto count = ::write(descriptors[1], text.data() + written, text.size() - written);
+                if (count <= 0)
+                    break;
+                
+                written += static_cast<size_t>(count);
+            }
+            
+            ::close(descriptors[1]);
+        });
+        
+        // Closing the reading end first stops the writer, should parseFile() not read until the end
+        const auto outcome = outcomeOf(json::tryParseFile("/dev/fd/" + to_string(descriptors[0])));
+        ::close(descriptors[0]);
+        writer.join();
+        
+        check(outcome == expected, "parseFile() differs from parse() for a pipe");
+#endif
+    }
+    
+    //! Integers at the limits of 64 bits should survive being parsed and written again
+    void testIntegerRoundTrip()
+    {
+        const string text = "[18446744073709551615,9223372036854775808,9223372036854775807,-9223372036854775808,-1,0]";
+        
+        const auto value = json::parse(text);
+        check(json::LeanWriter().writeToString(value) == text, "LeanWriter changes " + text + " into " + json::LeanWriter().writeToString(value));
+        check(json::parse(json::PrettyWriter().writeToString(value)) == value, "PrettyWriter changes " + text);
+        
+        check(!value[0].isSignedInteger() && value[0].isUnsignedInteger(), "18446744073709551615 isn't just an unsigned integer");
+        check(!value[1].isSignedInteger() && value[1].isUnsignedInteger(), "9223372036854775808 isn't just an unsigned integer");
+        check(value[2].isSignedInteger() && value[2].isUnsignedInteger(), "9223372036854775807 isn't both a signed and unsigned integer");
+        check(value[3].isSignedInteger() && !value[3].isUnsignedInteger(), "-9223372036854775808 isn't just a signed integer");
+    }
+    
+    //! Reals should be decoded as json::Real, be it double or long double, on every path that reports them
+    void testReals()
+    {
+        struct Recorder : json::Handler
+        {
+            void real(json::Real number) override { this->number = number; }
+            json::Real number = 0;
+        };
+        
+        for (const char* text : { "0.1", "-2.5e-7", "12345.6789", "3.14159265358979323846264338327950288", "123456789012345678901234567890",
+                                  "1.7976931348623157e308", "2.2250738585072014e-308", "7e22", "9007199254740993.0" })
+        {
+            istringstream stream(text);
+            stream.imbue(locale::classic());
+            
+            json::Real expected = 0;
+            stream >> expected;
+            
+            check(json::parse(text).asReal() == expected, string("parse() decodes ") + text + " wrongly");
+            
+            Recorder recorder;
+            json::parse(text, recorder);
+            check(recorder.number == expected, string("a handler receives ") + text + " wrongly");
+            
+            json::Cursor cursor(text);
+            check(cursor.asReal() == expected, string("a cursor reads ") + text + " wrongly");
+        }
+        
+        // With long doubles, digits beyond the precision of a double are kept
+        if constexpr (sizeof(json::Real) > sizeof(double))
+            check(json::parse("0.1").asReal() != static_cast<json::Real>(0.1), "parse() decodes reals as double before storing them as long double");
+    }
+    
+    //! Reading records into the reader's own arena should give the same as reading them into values of ours
+    void testLineReader()
+    {
+        string text;
+        for (size_t i = 0; i < 2000; ++i)
+        {
+            auto record = generateValue(1);
+            replace(record.begin(), record.end(), '\n', ' ');
+            if (i % 10 == 0)
+                mutate(record);
+            
+            text += record + "\n";
+        }
+        
+        json::LineReader ours(text);
+        json::LineReader arena(text);
+        
+        // Broken records may have been split in two, so read until our reader runs out
+        for (size_t i = 0;; ++i)
+        {
+            Outcome expected;
+            try
+            {
+                if (!ours.read(expected.value))
+                    break;
+            } catch (const json::Error& error) {
+                expected.error = error.getCode();
+                expected.line = error.getLine();
+                expected.character = error.getCharacter();
+            }
+            
+            Outcome outcome;
+            try
+            {
+                check(arena.read(), "LineReader::read() runs out of records early");
+                outcome.value = arena.getRecord();
+            } catch (const json::Error& error) {
+                outcome.error = error.getCode();
+                outcome.line = error.getLine();
+                outcome.character = error.getCharacter();
+                check(arena.getRecord().isNull(), "LineReader::read() keeps a record that failed to parse");
+            }
+            
+            check(outcome == expected, "LineReader::read() differs from reading into a value, at record " + to_string(i));
+        }
+        
+        check(!arena.read() && arena.getRecord().isNull(), "LineReader::read() finds more records than there are");
+    }
+    
+    //! Feeding a PushParser, byte by byte or in random chunks, should give the same as parsing at once
+    void testPushParser()
+    {
+        for (size_t i = 0; i < 5000; ++i)
+        {
+            auto text = generateValue();
+            if (i % 2)
+                mutate(text);
+            
+            json::ParseOptions options;
+            options.acceptComments = i % 3 != 0;
+            options.acceptCommaAfterLastEntry = i % 5 != 0;
+            options.maxDepth = i % 11 == 0 ? 3 : 1024;
+            
+            vector<size_t> cuts;
+            if (i % 4 == 0)
+            {
+                for (size_t cut = 0; cut <= text.size(); ++cut)
+                    cuts.push_back(cut);
+            } else {
+                for (size_t count = pick(8); cuts.size() < count;)
+                    cuts.push_back(pick(text.size() + 1));
+                
+                sort(cuts.begin(), cuts.end());
+            }
+            
+            const auto expected = parseAtOnce(text, options);
+            check(parseInChunks(text, cuts, options) == expected, "PushParser differs from parse() for " + text);
+        }
+    }
+}
+
+int main()
+{
+    testPushParser();
+    testIntegerRoundTrip();
+    testReals();
+    testLineReader();
+    testUtf8Validation();
+    testNesting();
+    testParseLinesRethrows();
+    testParallelArray();
+    testParseFile();
+    
+    if (failures != 0)
+    {
+        cerr << failures << " checks failed" << endl;
+        return 1;
+    }
+    
+    cout << "All checks passed" << endl;
+    return 0;
+}
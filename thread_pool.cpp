@@ -0,0 +1,118 @@
+//
+//  thread_pool.cpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#include <algorithm>
+#include <utility>
+
+#include "thread_pool.hpp"
+
+using namespace std;
+
+namespace json
+{
+    ThreadPool::ThreadPool(size_t threadCount)
+    {
+        if (threadCount == 0)
+            threadCount = getDefaultThreadCount();
+        
+        for (size_t i = 0; i < threadCount; ++i)
+            queues.push_back(make_unique<Queue>());
+        
+        for (size_t i = 0; i < threadCount; ++i)
+            threads.emplace_back([this, i] { work(i); });
+    }
+    
+    ThreadPool::~ThreadPool()
+    {
+        {
+            lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        
+        wake.notify_all();
+        for (auto& thread : threads)
+            thread.join();
+    }
+    
+    void ThreadPool::submit(function<void()> task)
+    {
+        // Only submit() touches nextQueue, from the thread that owns the pool
+        auto& queue = *queues[nextQueue];
+        nextQueue = (nextQueue + 1) % queues.size();
+        
+        // Count the task before queueing it, so that taking it never brings the count below zero
+        {
+            lock_guard<std::mutex> lock(mutex);
+            ++pending;
+        }
+        
+        {
+            lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        
+        wake.notify_one();
+    }
+    
+    size_t ThreadPool::getThreadCount() const
+    {
+        return threads.size();
+    }
+    
+    size_t ThreadPool::getDefaultThreadCount()
+    {
+        return max<size_t>(thread::hardware_concurrency(), 1);
+    }
+    
+    void ThreadPool::work(size_t index)
+    {
+        function<void()> task;
+        while (true)
+        {
+            if (take(index, task))
+            {
+                task();
+                task = nullptr;
+                continue;
+            }
+            
+            unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || pending > 0; });
+            if (stopping)
+                return;
+        }
+    }
+    
+    bool ThreadPool::take(size_t index, function<void()>& task)
+    {
+        // Our own queue first, oldest task first, then the newest of another
+        for (size_t i = 0; i < queues.size(); ++i)
+        {
+            auto& queue = *queues[(index + i) % queues.size()];
+            
+            lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+                continue;
+            
+            if (i == 0)
+            {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            } else {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            
+            lock_guard<std::mutex> pendingLock(mutex);
+            --pending;
+            return true;
+        }
+        
+        return false;
+    }
+}
@@ -0,0 +1,81 @@
+//
+//  thread_pool.hpp
+//  Jsonata
+//
+//  Copyright © 2015-2016 Dsperados (info@dsperados.com). All rights reserved.
+//  Licensed under the BSD 3-clause license.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace json
+{
+    //! Runs tasks on a fixed number of threads
+    /*! Every thread has its own queue, which tasks are spread over. A thread whose queue runs dry steals
+        from the back of the others, so that a few slow tasks don't hold up the rest. Tasks are meant to be
+        coarse (such as parsing a chunk of input), so the queues are simply guarded by a mutex each. */
+    class ThreadPool
+    {
+    public:
+        //! Start the threads
+        /*! @param threadCount The number of threads, or 0 for one per hardware thread */
+        explicit ThreadPool(std::size_t threadCount);
+        
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        
+        //! Let the tasks that are running finish, and stop the threads
+        /*! Tasks that haven't started yet are dropped */
+        ~ThreadPool();
+        
+        //! Queue a task, to be run on one of the threads
+        void submit(std::function<void()> task);
+        
+        std::size_t getThreadCount() const;
+        
+    public:
+        //! Return the number of threads to use, when 0 was asked for
+        static std::size_t getDefaultThreadCount();
+        
+    private:
+        //! The tasks queued for a thread
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+        
+    private:
+        //! The loop of each thread
+        void work(std::size_t index);
+        
+        //! Take a task from a thread's own queue, or steal one from another
+        /*! @return false if all queues are empty */
+        bool take(std::size_t index, std::function<void()>& task);
+        
+    private:
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> threads;
+        
+        //! The queue that the next task goes into
+        std::size_t nextQueue = 0;
+        
+        //! Guards the members below, and wakes up threads waiting for tasks
+        std::mutex mutex;
+        std::condition_variable wake;
+        
+        //! The number of tasks that have been submitted, but not taken
+        std::size_t pending = 0;
+        
+        bool stopping = false;
+    };
+}
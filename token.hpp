@@ -7,9 +7,13 @@
 
 #pragma once
 
-#include <string>
+#include <cstddef>
+#include <cstdint>
 #include <string_view>
 
+#include "error.hpp"
+#include "real.hpp"
+
 namespace json
 {
     class Token
@@ -29,26 +33,51 @@ namespace json
             STRING,
             NIL,
             END_OF_FILE,
-            UNKNOWN
+            UNKNOWN,
+            INCOMPLETE //!< The input ran out halfway a token, but more may be fed (see Lexer::feed())
+        };
+        
+        //! How the value of a number token is stored
+        enum class NumberType
+        {
+            SIGNED,
+            UNSIGNED,
+            REAL
         };
         
     public:
         Token() : type(Type::END_OF_FILE) { }
         
-        Token(Type type, std::string_view lexeme, std::size_t line, std::size_t character) :
+        Token(Type type, std::string_view lexeme, std::size_t offset) :
             type(type),
             lexeme(lexeme),
-            line(line),
-            character(character)
+            offset(offset)
         {
             
         }
         
     public:
         Type type = Type::UNKNOWN;
-        std::string lexeme;
         
-        std::size_t line = 0;
-        std::size_t character = 0;
+        //! The text of the token, viewing into the lexer's input or scratch buffer
+        /*! Strings are stored without quotes and with their escape sequences resolved.
+            @warning This is only valid until the next token is requested from the lexer */
+        std::string_view lexeme;
+        
+        //! The byte offset of the token in the input
+        /*! Pass this to Lexer::getPosition() to get its line and character */
+        std::size_t offset = 0;
+        
+        //! Why an unknown token couldn't be lexed
+        ErrorCode error = ErrorCode::UNEXPECTED_TOKEN;
+        
+        //! The value of a number token, as decoded by the lexer
+        NumberType numberType = NumberType::SIGNED;
+        union
+        {
+            std::int64_t signedInteger = 0;
+            std::uint64_t unsignedInteger;
+            Real real;
+        };
     };
 }
@@ -7,6 +7,9 @@
 //
 
 #include <cmath>
+#include <cstring>
+#include <limits>
+#include <new>
 #include <stdexcept>
 
 #include "value.hpp"
@@ -19,6 +22,8 @@ namespace json
     const Value Value::emptyArray = Value::Array{};
     const Value Value::emptyObject = Value::Object{};
     
+    static_assert(sizeof(Value::Real) > 8 || sizeof(Value) == 16, "Json values should take 16 bytes");
+    
     Value::Value() : type(Type::NIL) { }
     Value::Value(Null) { *this = null; }
     Value::Value(bool boolean) { *this = boolean; }
@@ -32,48 +37,63 @@ namespace json
 	Value::Value(long long unsigned int number) { *this = number; }
 	Value::Value(double number) { *this = number; }
     Value::Value(long double number) { *this = number; }
-    Value::Value(const std::string& string) { *this = string; }
-    Value::Value(std::string_view string) { *this = string; }
+    Value::Value(const std::string& string) { constructString(string, nullptr); }
+    Value::Value(std::string_view string) { constructString(string, nullptr); }
     Value::Value(const Array& array) { *this = array; }
+    Value::Value(Array&& array) { *this = move(array); }
     Value::Value(const Object& object) { *this = object; }
+    Value::Value(Object&& object) { *this = move(object); }
 
 	Value::Value(const char* string)
 	{
 		*this = string;
 	}
     
-    Value::Value(const Value& rhs)
+    Value::Value(std::string_view string, Arena& arena)
     {
-        type = rhs.type;
-        switch (type)
-        {
-            case Type::NIL: break;
-            case Type::BOOLEAN: boolean = rhs.boolean; break;
-            case Type::SIGNED: signedInt = rhs.signedInt; break;
-            case Type::UNSIGNED: unsignedInt = rhs.unsignedInt; break;
-            case Type::REAL: real = rhs.real; break;
-            case Type::STRING: new (&string) std::string(rhs.string); break;
-            case Type::ARRAY: new (&array) unique_ptr<Array>(new Array(*rhs.array)); break;
-            case Type::OBJECT: new (&object) unique_ptr<Object>(new Object(*rhs.object)); break;
-        }
+        constructString(string, &arena);
     }
     
-    Value::Value(Value&& rhs)
+    Value::Value(Array&& array, Arena& arena)
     {
-        type = rhs.type;
-        switch (type)
-        {
-            case Type::NIL: break;
-            case Type::BOOLEAN: boolean = rhs.boolean; break;
-            case Type::SIGNED: signedInt = rhs.signedInt; break;
-            case Type::UNSIGNED: unsignedInt = rhs.unsignedInt; break;
-            case Type::REAL: real = rhs.real; break;
-            case Type::STRING: new (&string) std::string(move(rhs.string)); break;
-            case Type::ARRAY: new (&array) unique_ptr<Array>(move(rhs.array)); break;
-            case Type::OBJECT: new (&object) unique_ptr<Object>(move(rhs.object)); break;
-        }
+        auto moved = new (arena.allocate(sizeof(Array), alignof(Array))) Array(Allocator<Value>(&arena));
+        moved->reserve(array.size());
+        for (auto& element : array)
+            moved->emplace_back(move(element));
         
-        rhs = null;
+        type = Type::ARRAY;
+        store(moved);
+        
+        // The elements that were moved in may hold contents outside of the arena
+        flags = moved->empty() ? inArena : inArena | modified;
+    }
+    
+    Value::Value(Object&& object, Arena& arena)
+    {
+        auto moved = new (arena.allocate(sizeof(Object), alignof(Object))) Object(Allocator<Value>(&arena));
+        moved->reserve(object.size());
+        for (auto& pair : object)
+            moved->append(pair.first, move(pair.second));
+        
+        type = Type::OBJECT;
+        store(moved);
+        
+        // The fields that were moved in may hold contents outside of the arena
+        flags = moved->empty() ? inArena : inArena | modified;
+    }
+    
+    Value::Value(const Value& rhs)
+    {
+        copyFrom(rhs);
+    }
+    
+    Value::Value(Value&& rhs) noexcept :
+        type(rhs.type)
+    {
+        // Whatever rhs holds on the heap is taken over along with the pointer to it
+        copyStorage(rhs);
+        rhs.type = Type::NIL;
+        rhs.flags = 0;
     }
     
     Value::~Value()
@@ -85,7 +105,7 @@ namespace json
 	{
         destruct();
         type = Type::NIL;
-        
+		
 		return *this;
 	}
     
@@ -93,90 +113,91 @@ namespace json
     {
         destruct();
         type = Type::BOOLEAN;
-        this->boolean = boolean;
+        store(boolean);
         
         return *this;
     }
 
 	Value& Value::operator=(const char* string)
 	{
-		return *this = std::string(string);
+        if (!string)
+            throw invalid_argument("Json string value can't be assigned a nullptr");
+		
+		return *this = std::string_view(string);
 	}
 
     Value& Value::operator=(const std::string& string)
 	{
-        destruct();
-        type = Type::STRING;
-        new (&this->string) std::string(string);
-        
-		return *this;
+		return *this = std::string_view(string);
 	}
     
     Value& Value::operator=(std::string_view string)
     {
-        destruct();
-        type = Type::STRING;
-        new (&this->string) std::string(string);
-        
-        return *this;
+        // Construct before destructing, in case the string is stored in this value
+        Value value(string);
+        return *this = std::move(value);
     }
 
 	Value& Value::operator=(const Array& array)
 	{
+        auto copy = new Array(array);
         destruct();
         type = Type::ARRAY;
-        new (&this->array) unique_ptr<Array>(new Array(array));
-        
+        store(copy);
+		
 		return *this;
 	}
+    
+    Value& Value::operator=(Array&& array)
+    {
+        auto moved = new Array(move(array));
+        destruct();
+        type = Type::ARRAY;
+        store(moved);
+        
+        return *this;
+    }
 
 	Value& Value::operator=(const Object& object)
 	{
+        auto copy = new Object(object);
         destruct();
         type = Type::OBJECT;
-        new (&this->object) unique_ptr<Object>(new Object(object));
-        
+        store(copy);
+		
 		return *this;
 	}
     
-    Value& Value::operator=(const Value& rhs)
+    Value& Value::operator=(Object&& object)
     {
+        auto moved = new Object(move(object));
         destruct();
-        
-        type = rhs.type;
-        switch (type)
-        {
-            case Type::NIL: break;
-            case Type::BOOLEAN: boolean = rhs.boolean; break;
-            case Type::SIGNED: signedInt = rhs.signedInt; break;
-            case Type::UNSIGNED: unsignedInt = rhs.unsignedInt; break;
-            case Type::REAL: real = rhs.real; break;
-            case Type::STRING: new (&string) std::string(rhs.string); break;
-            case Type::ARRAY: new (&array) unique_ptr<Array>(new Array(*rhs.array)); break;
-            case Type::OBJECT: new (&object) unique_ptr<Object>(new Object(*rhs.object)); break;
-        }
+        type = Type::OBJECT;
+        store(moved);
         
         return *this;
     }
     
-    Value& Value::operator=(Value&& rhs)
+    Value& Value::operator=(const Value& rhs)
     {
-        destruct();
+        // Copy before destructing, in case rhs is nested inside this value
+        Value copy(rhs);
+        return *this = std::move(copy);
+    }
+    
+    Value& Value::operator=(Value&& rhs) noexcept
+    {
+        if (&rhs == this)
+            return *this;
         
-        type = rhs.type;
-        switch (type)
-        {
-            case Type::NIL: break;
-            case Type::BOOLEAN: boolean = rhs.boolean; break;
-            case Type::SIGNED: signedInt = rhs.signedInt; break;
-            case Type::UNSIGNED: unsignedInt = rhs.unsignedInt; break;
-            case Type::REAL: real = rhs.real; break;
-            case Type::STRING: new (&string) std::string(move(rhs.string)); break;
-            case Type::ARRAY: new (&array) unique_ptr<Array>(move(rhs.array)); break;
-            case Type::OBJECT: new (&object) unique_ptr<Object>(move(rhs.object)); break;
-        }
+        // Take rhs over before destructing, in case rhs is nested inside this value
+        Value taken(std::move(rhs));
+        destruct();
         
-        rhs = null;
+        type = taken.type;
+        copyStorage(taken);
+        taken.type = Type::NIL;
+        taken.flags = 0;
         
         return *this;
     }
@@ -185,8 +206,8 @@ namespace json
 	bool Value::isBool() const { return type == Type::BOOLEAN; }
     bool Value::isNumber() const { return isInteger() || isReal(); }
     bool Value::isInteger() const { return isSignedInteger() || isUnsignedInteger(); }
-    bool Value::isSignedInteger() const { return type == Type::SIGNED || type == Type::UNSIGNED; }
-    bool Value::isUnsignedInteger() const { return type == Type::UNSIGNED || (type == Type::SIGNED && signedInt >= 0); }
+    bool Value::isSignedInteger() const { return type == Type::SIGNED || (type == Type::UNSIGNED && load<uint64_t>() <= static_cast<uint64_t>(numeric_limits<int64_t>::max())); }
+    bool Value::isUnsignedInteger() const { return type == Type::UNSIGNED || (type == Type::SIGNED && load<int64_t>() >= 0); }
     bool Value::isReal() const { return type == Type::REAL; }
 	bool Value::isString() const { return type == Type::STRING; }
 	bool Value::isArray() const { return type == Type::ARRAY; }
@@ -197,17 +218,17 @@ namespace json
 		if (!isBool())
 			throw runtime_error("Json value is not a boolean, yet asBool() was called on it");
 
-        return boolean;
+        return load<bool>();
 	}
     
     int64_t Value::asSignedInteger() const
     {
         switch (type)
         {
-            case Type::SIGNED: return signedInt;
-            case Type::UNSIGNED: return static_cast<int64_t>(unsignedInt);
-            case Type::REAL: return static_cast<int64_t>(real);
-                
+            case Type::SIGNED: return load<int64_t>();
+            case Type::UNSIGNED: return static_cast<int64_t>(load<uint64_t>());
+            case Type::REAL: return static_cast<int64_t>(load<Real>());
+            
             case Type::NIL:
             case Type::BOOLEAN:
             case Type::STRING:
@@ -221,10 +242,10 @@ namespace json
     {
         switch (type)
         {
-            case Type::SIGNED: return static_cast<uint64_t>(signedInt);
-            case Type::UNSIGNED: return unsignedInt;
-            case Type::REAL: return static_cast<uint64_t>(real);
-                
+            case Type::SIGNED: return static_cast<uint64_t>(load<int64_t>());
+            case Type::UNSIGNED: return load<uint64_t>();
+            case Type::REAL: return static_cast<uint64_t>(load<Real>());
+            
             case Type::NIL:
             case Type::BOOLEAN:
             case Type::STRING:
@@ -234,14 +255,14 @@ namespace json
         }
     }
 
-	long double Value::asReal() const
+	Value::Real Value::asReal() const
 	{
         switch (type)
         {
-            case Type::SIGNED: return static_cast<long double>(signedInt);
-            case Type::UNSIGNED: return static_cast<long double>(unsignedInt);
-            case Type::REAL: return real;
-                
+            case Type::SIGNED: return static_cast<Real>(load<int64_t>());
+            case Type::UNSIGNED: return static_cast<Real>(load<uint64_t>());
+            case Type::REAL: return load<Real>();
+            
             case Type::NIL:
             case Type::BOOLEAN:
             case Type::STRING:
@@ -251,12 +272,12 @@ namespace json
         }
 	}
 
-	const string& Value::asString() const
+	string_view Value::asString() const
 	{
 		if (!isString())
 			throw runtime_error("Json value is not a string, yet asString() was called on it");
 
-        return string;
+        return getString();
 	}
     
     const Value::Array& Value::asArray() const
@@ -264,7 +285,7 @@ namespace json
         if (!isArray())
             throw runtime_error("Json value is not an array, yet asArray() was called on it");
         
-        return *array;
+        return getArray();
     }
     
     const Value::Object& Value::asObject() const
@@ -272,7 +293,7 @@ namespace json
         if (!isObject())
             throw runtime_error("Json value is not an object, yet asObject() was called on it");
         
-        return *object;
+        return getObject();
     }
 
 	void Value::append(const Value& value)
@@ -280,7 +301,31 @@ namespace json
         if (!isArray())
             *this = emptyArray;
         
-        array->emplace_back(value);
+        markModified();
+        getArray().emplace_back(value);
+    }
+    
+    void Value::append(Value&& value)
+    {
+        if (!isArray())
+            *this = Array{};
+        
+        markModified();
+        getArray().emplace_back(move(value));
+    }
+    
+    void Value::reserve(size_t capacity)
+    {
+        if (isObject())
+        {
+            getObject().reserve(capacity);
+            return;
+        }
+        
+        if (!isArray())
+            *this = Array{};
+        
+        getArray().reserve(capacity);
     }
 
 	Value& Value::operator[](size_t index)
@@ -291,7 +336,8 @@ namespace json
         if (index >= size())
             throw runtime_error("Json array value, index " + to_string(index) + " out of bounds");
         
-        return array->at(index);
+        markModified();
+        return getArray().at(index);
     }
     
     const Value& Value::operator[](size_t index) const
@@ -302,7 +348,7 @@ namespace json
         if (index >= size())
             throw runtime_error("Json array, index " + to_string(index) + " out of bounds");
         
-        return array->at(index);
+        return getArray().at(index);
     }
     
     Value Value::access(const size_t& index, const Value& alternative) const
@@ -318,7 +364,20 @@ namespace json
         if (!isObject())
             *this = emptyObject;
         
-        (*object)[std::string(key)] = value;
+        // The value is copied into place while appending, which keeps it valid if it is one of our elements
+        markModified();
+        if (auto result = getObject().try_emplace(key, value); !result.second)
+            result.first->second = value;
+    }
+    
+    void Value::insert(std::string_view key, Value&& value)
+    {
+        if (!isObject())
+            *this = Object{};
+        
+        markModified();
+        if (auto result = getObject().try_emplace(key, move(value)); !result.second)
+            result.first->second = move(value);
     }
     
     Value& Value::operator[](std::string_view key)
@@ -326,7 +385,8 @@ namespace json
         if (!isObject())
             *this = emptyObject;
         
-        return (*object)[std::string(key)];
+        markModified();
+        return getObject()[key];
     }
     
     const Value& Value::operator[](std::string_view key) const
@@ -334,27 +394,28 @@ namespace json
         if (!isObject())
             throw runtime_error("Json value is not an object, but tried to call operator[]() on it");
         
-        auto it = object->find(std::string(key));
-        if (it == object->end())
+        auto it = getObject().find(key);
+        if (it == getObject().end())
             throw runtime_error("Json object, key '" + std::string(key) + "' not found");
         
         return it->second;
     }
     
-    Value Value::access(const std::string& key, const Value& alternative) const
+    Value Value::access(std::string_view key, const Value& alternative) const
     {
-        if (!hasKey(key))
+        if (!isObject())
             return alternative;
         
-        return (*this)[key];
+        auto it = getObject().find(key);
+        return it != getObject().end() ? it->second : alternative;
     }
 
 	size_t Value::size() const
 	{
 		if (isArray())
-            return array->size();
+            return getArray().size();
         else if (isObject())
-            return object->size();
+            return getObject().size();
         else
             throw runtime_error("Json value is neither array nor object, but tried to call size() on it");
 	}
@@ -362,9 +423,9 @@ namespace json
 	bool Value::empty() const
 	{
 		if (isArray())
-            return array->empty();
+            return getArray().empty();
         else if (isObject())
-            return object->empty();
+            return getObject().empty();
         else
             throw runtime_error("Json value is neither array nor object, but tried to call empty() on it");
 	}
@@ -375,26 +436,28 @@ namespace json
             throw runtime_error("Json value is not an object, but tried to call keys() on it");
         
         vector<std::string> keys;
-        for (auto& pair : *object)
-            keys.emplace_back(pair.first);
+        for (auto& pair : getObject())
+            keys.emplace_back(string_view(pair.first));
 
         return keys;
     }
     
-    bool Value::hasKey(const std::string& key) const
+    bool Value::hasKey(std::string_view key) const
     {
         if (!isObject())
             return false;
         
-        return object->count(key) > 0;
+        return getObject().count(key) > 0;
     }
 
     Value::Iterator Value::begin()
     {
+        markModified();
+    	
     	if (isArray())
-            return array->begin();
+            return getArray().begin();
         else if (isObject())
-            return object->begin();
+            return getObject().begin();
         else
             throw runtime_error("Json value is neither array nor object, but tried to call begin() on it");
     }
@@ -402,9 +465,9 @@ namespace json
     Value::ConstIterator Value::begin() const
     {
         if (isArray())
-            return array->cbegin();
+            return getArray().cbegin();
         else if (isObject())
-            return object->cbegin();
+            return getObject().cbegin();
         else
             throw runtime_error("Json value is neither array nor object, but tried to call begin() on it");
     }
@@ -412,19 +475,21 @@ namespace json
     Value::ConstIterator Value::cbegin() const
     {
         if (isArray())
-            return array->cbegin();
+            return getArray().cbegin();
         else if (isObject())
-            return object->cbegin();
+            return getObject().cbegin();
         else
             throw runtime_error("Json value is neither array nor object, but tried to call begin() on it");
     }
 
     Value::Iterator Value::end()
     {
+        markModified();
+    	
     	if (isArray())
-            return array->end();
+            return getArray().end();
         else if (isObject())
-            return object->end();
+            return getObject().end();
         else
             throw runtime_error("Json value is neither array nor object, but tried to call end() on it");
     }
@@ -432,9 +497,9 @@ namespace json
     Value::ConstIterator Value::end() const
     {
         if (isArray())
-            return array->cend();
+            return getArray().cend();
         else if (isObject())
-            return object->cend();
+            return getObject().cend();
         else
             throw runtime_error("Json value is neither array nor object, but tried to call end() on it");
     }
@@ -442,15 +507,116 @@ namespace json
     Value::ConstIterator Value::cend() const
     {
         if (isArray())
-            return array->cend();
+            return getArray().cend();
         else if (isObject())
-            return object->cend();
+            return getObject().cend();
         else
             throw runtime_error("Json value is neither array nor object, but tried to call end() on it");
     }
     
+    //! How many arrays and objects this thread is destructing or copying recursively
+    static thread_local std::size_t recursionDepth = 0;
+    
+    //! Counts towards recursionDepth for as long as it lives
+    struct RecursionScope
+    {
+        RecursionScope() { ++recursionDepth; }
+        ~RecursionScope() { --recursionDepth; }
+    };
+    
+    void Value::constructString(string_view string, Arena* arena)
+    {
+        if (string.size() <= storageSize)
+        {
+            stringSize = static_cast<uint8_t>(string.size());
+            if (!string.empty())
+                memcpy(storage, string.data(), string.size());
+        } else {
+            // Long strings are stored on the heap or in the arena, behind their size
+            const auto size = string.size();
+            auto block = static_cast<char*>(arena ? arena->allocate(sizeof(size) + size, alignof(size_t)) : ::operator new(sizeof(size) + size));
+            memcpy(block, &size, sizeof(size));
+            memcpy(block + sizeof(size), string.data(), size);
+            
+            stringSize = longString;
+            flags = arena ? inArena : 0;
+            store(block);
+        }
+        
+        type = Type::STRING;
+    }
+    
+    string_view Value::getString() const
+    {
+        if (stringSize != longString)
+            return {storage, stringSize};
+        
+        const auto block = load<const char*>();
+        size_t size;
+        memcpy(&size, block, sizeof(size));
+        
+        return {block + sizeof(size), size};
+    }
+    
     void Value::destruct()
     {
+        // Only arrays and objects recurse, so nothing else needs to keep track of the depth
+        if (type != Type::ARRAY && type != Type::OBJECT)
+        {
+            if (type == Type::STRING && stringSize == longString && !(flags & inArena))
+                ::operator delete(load<char*>());
+            
+            flags = 0;
+            return;
+        }
+        
+        // Let the containers destruct their elements recursively, unless that could overflow the stack
+        if (recursionDepth < maxRecursionDepth)
+        {
+            RecursionScope scope;
+            
+            // What is allocated from an arena is freed by the arena, apart from the elements that may have been
+            // given contents outside of it after they were allocated
+            if (!(flags & inArena))
+            {
+                if (type == Type::ARRAY)
+                    delete load<Array*>();
+                else
+                    delete load<Object*>();
+            } else if (flags & modified) {
+                if (type == Type::ARRAY)
+                {
+                    for (auto& element : getArray())
+                        element.destruct();
+                } else if (type == Type::OBJECT) {
+                    for (auto& pair : getObject())
+                        pair.second.destruct();
+                }
+            }
+            
+            flags = 0;
+            return;
+        }
+        
+        std::vector<Value> deep;
+        destruct(0, deep);
+        flags = 0;
+        
+        while (!deep.empty())
+        {
+            auto value = std::move(deep.back());
+            deep.pop_back();
+            value.destruct(0, deep);
+            value.type = Type::NIL;
+        }
+    }
+    
+    void Value::destruct(std::size_t depth, std::vector<Value>& deep)
+    {
+        // Containers in an arena only have their elements destructed, and only if they were modified
+        const auto owned = !(flags & inArena);
+        const auto nested = owned || (flags & modified);
+        
         switch (type)
         {
             case Type::NIL:
@@ -460,33 +626,215 @@ namespace json
             case Type::REAL:
                 break;
             case Type::STRING:
-                string.~basic_string();
+                if (owned && stringSize == longString)
+                    ::operator delete(load<char*>());
+                
+                break;
+            case Type::ARRAY:
+                if (auto array = load<Array*>(); array && nested)
+                {
+                    for (auto& element : *array)
+                        element.destructNested(depth + 1, deep);
+                    
+                    if (owned)
+                        delete array;
+                }
+                
                 break;
+            case Type::OBJECT:
+                if (auto object = load<Object*>(); object && nested)
+                {
+                    for (auto& pair : *object)
+                        pair.second.destructNested(depth + 1, deep);
+                    
+                    if (owned)
+                        delete object;
+                }
+                
+                break;
+        }
+    }
+    
+    void Value::destructNested(std::size_t depth, std::vector<Value>& deep)
+    {
+        // Numbers and booleans own nothing
+        if (type != Type::STRING && type != Type::ARRAY && type != Type::OBJECT)
+            return;
+        
+        // Strings are destructed here rather than by their container, which doesn't do so if it's in an arena
+        if (type == Type::STRING || depth < maxRecursionDepth)
+        {
+            destruct(depth, deep);
+            type = Type::NIL;
+        } else {
+            deep.emplace_back(std::move(*this));
+        }
+    }
+    
+    void Value::copyFrom(const Value& rhs)
+    {
+        // Only arrays and objects recurse, so nothing else needs to keep track of the depth
+        switch (rhs.type)
+        {
+            case Type::NIL: type = rhs.type; return;
+            case Type::BOOLEAN:
+            case Type::SIGNED:
+            case Type::UNSIGNED:
+            case Type::REAL: copyStorage(rhs); type = rhs.type; return;
+            case Type::STRING: constructString(rhs.getString(), nullptr); return;
+            case Type::ARRAY:
+            case Type::OBJECT: break;
+        }
+        
+        // Let the containers copy their elements recursively, unless that could overflow the stack
+        if (recursionDepth < maxRecursionDepth)
+        {
+            RecursionScope scope;
+            if (rhs.type == Type::ARRAY)
+                store(new Array(rhs.getArray()));
+            else
+                store(new Object(rhs.getObject()));
+            
+            type = rhs.type;
+            return;
+        }
+        
+        std::vector<std::pair<Value*, const Value*>> deep;
+        copyFrom(rhs, 0, deep);
+        
+        while (!deep.empty())
+        {
+            const auto [to, from] = deep.back();
+            deep.pop_back();
+            to->copyFrom(*from, 0, deep);
+        }
+    }
+    
+    void Value::copyFrom(const Value& rhs, std::size_t depth, std::vector<std::pair<Value*, const Value*>>& deep)
+    {
+        // Nested arrays and objects are copied in place, or left null and scheduled if they're too deep
+        const auto copyNested = [&](Value& to, const Value& from)
+        {
+            if ((from.type == Type::ARRAY || from.type == Type::OBJECT) && depth + 1 >= maxRecursionDepth)
+                deep.emplace_back(&to, &from);
+            else
+                to.copyFrom(from, depth + 1, deep);
+        };
+        
+        switch (rhs.type)
+        {
+            case Type::NIL: break;
+            case Type::BOOLEAN:
+            case Type::SIGNED:
+            case Type::UNSIGNED:
+            case Type::REAL: copyStorage(rhs); break;
+            case Type::STRING: constructString(rhs.getString(), nullptr); break;
             case Type::ARRAY:
-                array.~unique_ptr<Array>();
+            {
+                auto array = new Array;
+                store(array);
+                array->reserve(rhs.getArray().size());
+                
+                for (auto& element : rhs.getArray())
+                    copyNested(array->emplace_back(), element);
+                
                 break;
+            }
             case Type::OBJECT:
-                object.~unique_ptr<Object>();
+            {
+                auto object = new Object;
+                store(object);
+                object->reserve(rhs.getObject().size());
+                
+                // The keys are known to be unique already, so they're appended without being looked up
+                for (auto& pair : rhs.getObject())
+                    copyNested(object->append(pair.first)->second, pair.second);
+                
                 break;
+            }
         }
+        
+        type = rhs.type;
+    }
+    
+    bool Value::equals(const Value& lhs, const Value& rhs, std::size_t depth, std::vector<std::pair<const Value*, const Value*>>& deep)
+    {
+        if (lhs.type != rhs.type)
+            return false;
+        
+        // Nested arrays and objects are compared in place, or scheduled if they're too deep
+        const auto equalsNested = [&](const Value& a, const Value& b)
+        {
+            if ((a.type == Type::ARRAY || a.type == Type::OBJECT) && depth + 1 >= maxRecursionDepth)
+            {
+                deep.emplace_back(&a, &b);
+                return true;
+            }
+            
+            return equals(a, b, depth + 1, deep);
+        };
+        
+        switch (lhs.type)
+        {
+            case Type::NIL: return true;
+            case Type::BOOLEAN: return lhs.load<bool>() == rhs.load<bool>();
+            case Type::UNSIGNED: return lhs.load<uint64_t>() == rhs.load<uint64_t>();
+            case Type::SIGNED: return lhs.load<int64_t>() == rhs.load<int64_t>();
+            case Type::REAL: return lhs.load<Real>() == rhs.load<Real>();
+            case Type::STRING: return lhs.getString() == rhs.getString();
+            case Type::ARRAY:
+            {
+                const auto& a = lhs.getArray();
+                const auto& b = rhs.getArray();
+                if (a.size() != b.size())
+                    return false;
+                
+                for (std::size_t i = 0; i < a.size(); ++i)
+                {
+                    if (!equalsNested(a[i], b[i]))
+                        return false;
+                }
+                
+                return true;
+            }
+            case Type::OBJECT:
+            {
+                const auto& lhsObject = lhs.getObject();
+                const auto& rhsObject = rhs.getObject();
+                if (lhsObject.size() != rhsObject.size())
+                    return false;
+                
+                // Objects with the same fields are equal, regardless of the order in which they were inserted
+                for (auto& pair : lhsObject)
+                {
+                    const auto it = rhsObject.find(pair.first);
+                    if (it == rhsObject.end() || !equalsNested(pair.second, it->second))
+                        return false;
+                }
+                
+                return true;
+            }
+        }
+        
+        return false;
     }
 
 	bool operator==(const Value& lhs, const Value& rhs)
 	{
-        if (lhs.type != rhs.type)
+        std::vector<std::pair<const Value*, const Value*>> deep;
+        if (!Value::equals(lhs, rhs, 0, deep))
             return false;
         
-        switch (lhs.type)
+        while (!deep.empty())
         {
-            case Value::Type::NIL: return true;
-            case Value::Type::BOOLEAN: return lhs.boolean == rhs.boolean;
-            case Value::Type::UNSIGNED: return lhs.unsignedInt == rhs.unsignedInt;
-            case Value::Type::SIGNED: return lhs.signedInt == rhs.signedInt;
-            case Value::Type::REAL: return lhs.real == rhs.real;
-            case Value::Type::STRING: return lhs.string == rhs.string;
-            case Value::Type::ARRAY: return lhs.array == rhs.array;
-            case Value::Type::OBJECT: return lhs.object == rhs.object;
+            const auto [a, b] = deep.back();
+            deep.pop_back();
+            
+            if (!Value::equals(*a, *b, 0, deep))
+                return false;
         }
+        
+        return true;
 	}
 
 	bool operator!=(const Value& lhs, const Value& rhs)
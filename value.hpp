@@ -11,29 +11,39 @@
 
 #include <cstddef>
 #include <cstdint>
-#include <map>
-#include <memory>
+#include <cstring>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
+#include "arena.hpp"
+#include "ordered_map.hpp"
+#include "real.hpp"
+
 namespace json
 {
 	//! A json value
-	class Value
+    /*! Values take 16 bytes. Numbers and booleans are stored in place, and so are strings of up to 13 bytes.
+        Longer strings, arrays and objects are stored on the heap, or in an arena (see Arena). */
+	class alignas(8) Value
 	{
         friend bool operator==(const Value& lhs, const Value& rhs);
         friend bool operator!=(const Value& lhs, const Value& rhs);
+        friend class ValueBuilder;
         
     public:
         //! Generic null value type
         enum class Null;
         
         //! Convenience alias for Json arrays
-        using Array = std::vector<Value>;
+        using Array = std::vector<Value, Allocator<Value>>;
+        
+        //! Convenience alias for Json objects, which keep their keys in the order they were inserted
+        using Object = OrderedMap<Value>;
         
-        //! Convenience alias for Json objects
-        using Object = std::map<std::string, Value>;
+        //! The type in which real numbers are stored, see json::Real
+        using Real = json::Real;
         
         class Iterator;
         class ConstIterator;
@@ -54,7 +64,7 @@ namespace json
             
             //! Return the key of an object key/value pair
             /*! @throw std::runtime_error if the accessor does not point to an object element */
-            const std::string& key();
+            std::string_view key();
             
             //! Return the array element, or value of object key/value pair this accessor points to
             Value& value();
@@ -98,7 +108,7 @@ namespace json
             
             //! Return the key of an object key/value pair
             /*! @throw std::runtime_error if the accessor does not point to an object element */
-            const std::string& key();
+            std::string_view key();
             
             //! Return the array element, or value of object key/value pair this accessor points to
             const Value& value();
@@ -207,7 +217,7 @@ namespace json
                 Object::const_iterator itObject;
             };
         };
-        
+		
 	public:
 
 	// Construction
@@ -229,15 +239,30 @@ namespace json
         Value(const std::string& string); //!< Construct a string value
 		Value(std::string_view string); //!< Construct a string value
 		Value(const Array& array); //!< Construct an array value
+        Value(Array&& array); //!< Construct an array value, taking over its elements
 		Value(const Object& object); //!< Construct an object value
+        Value(Object&& object); //!< Construct an object value, taking over its elements
 
+        //! Construct a string value, allocated from an arena if it's too long to be stored in place
+        /*! @warning The value should be destructed before the arena is released */
+        Value(std::string_view string, Arena& arena);
+        
+        //! Construct an array value, of which the elements are allocated from an arena
+        /*! @warning The value should be destructed before the arena is released */
+        Value(Array&& array, Arena& arena);
+        
+        //! Construct an object value, of which the fields are allocated from an arena
+        /*! @warning The value should be destructed before the arena is released */
+        Value(Object&& object, Arena& arena);
+		
 		//! Construct a string value
 		/*! @throw std::invalid_argument if the string is a nullptr */
 		Value(const char* string);
         
         //! Copy and move
+        /*! Moving doesn't throw, so that containers of values move rather than copy them when growing */
         Value(const Value& rhs);
-        Value(Value&& rhs);
+        Value(Value&& rhs) noexcept;
         
         ~Value();
 
@@ -258,7 +283,7 @@ namespace json
 		{
             destruct();
             type = Type::SIGNED;
-            this->signedInt = static_cast<int64_t>(number);
+            store(static_cast<int64_t>(number));
             return *this;
 		}
         
@@ -271,7 +296,7 @@ namespace json
         {
             destruct();
             type = Type::UNSIGNED;
-            this->unsignedInt = static_cast<uint64_t>(number);
+            store(static_cast<uint64_t>(number));
             return *this;
         }
         
@@ -282,7 +307,7 @@ namespace json
         {
             destruct();
             type = Type::REAL;
-            this->real = static_cast<long double>(number);
+            store(static_cast<Real>(number));
             return *this;
         }
 
@@ -298,13 +323,19 @@ namespace json
 
 		//! Assign a new array value
 		Value& operator=(const Array& array);
+        
+        //! Assign a new array value, taking over its elements
+        Value& operator=(Array&& array);
 
 		//! Assign a new object value
 		Value& operator=(const Object& object);
         
+        //! Assign a new object value, taking over its elements
+        Value& operator=(Object&& object);
+        
         // Copy and move
         Value& operator=(const Value& rhs);
-        Value& operator=(Value&& rhs);
+        Value& operator=(Value&& rhs) noexcept;
 
 	// Predicates
 
@@ -312,8 +343,8 @@ namespace json
 		bool isBool() const; //!< Is this value a boolean?
 		bool isNumber() const; //!< Is this value a number?
         bool isInteger() const; //!< Is this value an integer number?
-        bool isSignedInteger() const; //!< Is this value a signed integer number?
-        bool isUnsignedInteger() const; //!< Is this value an unsigned integer number?
+        bool isSignedInteger() const; //!< Is this value an integer number that fits in a std::int64_t?
+        bool isUnsignedInteger() const; //!< Is this value an integer number that fits in a std::uint64_t?
         bool isReal() const; //!< Is this value a real number?
 		bool isString() const; //!< Is this value a string?
 		bool isArray() const; //!< Is this value a array?
@@ -335,11 +366,12 @@ namespace json
 
 		//! Retrieve the value as a real number
 		/*! @throw std::runtime_error if the value is not a number */
-		long double asReal() const;
+		Real asReal() const;
 
 		//! Retrieve the value as a string
-		/*! @throw std::runtime_error if the value is not a string */
-		const std::string& asString() const;
+		/*! @throw std::runtime_error if the value is not a string
+            @warning The string is only valid until the value is changed or destructed */
+		std::string_view asString() const;
         
         //! Retrieve the value as an array
         /*! @throw std::runtime_error if the value is not an array */
@@ -352,6 +384,27 @@ namespace json
 		//! Append a value, if this is an array
         /*! Changes the value into an array if it wasn't */
         void append(const Value& value);
+        
+        //! Append a value, if this is an array, moving it in
+        /*! Changes the value into an array if it wasn't */
+        void append(Value&& value);
+        
+        //! Construct a value at the end, if this is an array
+        /*! Changes the value into an array if it wasn't
+            @return The new element */
+        template <class... Args>
+        Value& emplaceBack(Args&&... args)
+        {
+            if (!isArray())
+                *this = Array{};
+            
+            markModified();
+            return getArray().emplace_back(std::forward<Args>(args)...);
+        }
+        
+        //! Reserve room for a number of elements, as array or object
+        /*! Changes the value into an array if it was neither an array nor an object */
+        void reserve(std::size_t capacity);
 
 		//! Access an element of the value as array
         /*! Changes the value into an array if it wasn't */
@@ -367,6 +420,26 @@ namespace json
         //! Sets one of the elements as object
         void insert(std::string_view key, const Value& value);
         
+        //! Sets one of the elements as object, moving in the value
+        void insert(std::string_view key, Value&& value);
+        
+        //! Construct one of the elements as object in place, replacing the element if the key already existed
+        /*! Changes the value into an object if it wasn't
+            @return The new element */
+        template <class... Args>
+        Value& emplace(std::string_view key, Args&&... args)
+        {
+            if (!isObject())
+                *this = Object{};
+            
+            markModified();
+            auto result = getObject().try_emplace(key, std::forward<Args>(args)...);
+            if (!result.second)
+                result.first->second = Value(std::forward<Args>(args)...);
+            
+            return result.first->second;
+        }
+        
         //! Access an element of the value as object
         /*! Changes the value into an object if it wasn't */
         Value& operator[](std::string_view key);
@@ -376,7 +449,7 @@ namespace json
         const Value& operator[](std::string_view key) const;
         
         //! Access an element of the value as object, or return an alternative if the key wasn't found
-        Value access(const std::string& key, const Value& alternative) const;
+        Value access(std::string_view key, const Value& alternative) const;
 
 		//! Return the size of the value (as an array or object)
 		/*! @throw std::runtime_error if the value is neither array nor object */
@@ -392,7 +465,7 @@ namespace json
         
         //! Does the value have an object key?
         /*! @return false if the value is not an object to begin with */
-        bool hasKey(const std::string& key) const;
+        bool hasKey(std::string_view key) const;
 
     // Ranged for-loops
 
@@ -416,26 +489,103 @@ namespace json
         
     private:
         // Can't use NULL, because of #define NULL 0
-        enum class Type { NIL, BOOLEAN, SIGNED, UNSIGNED, REAL, STRING, ARRAY, OBJECT };
+        enum class Type : std::uint8_t { NIL, BOOLEAN, SIGNED, UNSIGNED, REAL, STRING, ARRAY, OBJECT };
+        
+        //! How deep destructing, copying and comparing recurse, before continuing without recursion
+        static constexpr std::size_t maxRecursionDepth = 64;
+        
+        //! Where numbers, booleans and pointers are kept in the storage, so that they're aligned to 8 bytes
+        static constexpr std::size_t payloadOffset = 5;
+        
+        //! The size of the storage, all of which short strings can use
+        static constexpr std::size_t storageSize = payloadOffset + (sizeof(Real) > 8 ? sizeof(Real) : 8);
+        
+        //! Stands in for the size of short strings, to mark strings that are stored on the heap
+        static constexpr std::uint8_t longString = 0xFF;
+        
+        //! Flags for long strings, arrays and objects that are allocated from an arena
+        enum : std::uint8_t
+        {
+            //! The contents are allocated from an arena, which frees them, so they're not destructed
+            inArena = 1,
+            
+            //! The elements were given out to be changed, so they may hold contents outside of the arena.
+            //! Those elements are destructed, though the container itself still isn't.
+            modified = 2
+        };
         
     private:
-        //! Destruct the data in the union
+        //! Destruct the data in the storage
         void destruct();
+        
+        //! Copy the data of another value into the storage, which should not hold any data yet
+        void copyFrom(const Value& rhs);
+        
+        //! Copy the storage of another value bit for bit, without regard for what it owns
+        void copyStorage(const Value& rhs)
+        {
+            stringSize = rhs.stringSize;
+            flags = rhs.flags;
+            std::memcpy(storage, rhs.storage, storageSize);
+        }
+        
+        //! Read the number, boolean or pointer from the storage
+        template <class T>
+        T load() const
+        {
+            T value;
+            std::memcpy(&value, storage + payloadOffset, sizeof(T));
+            return value;
+        }
+        
+        //! Write a number, boolean or pointer into the storage
+        template <class T>
+        void store(T value)
+        {
+            std::memcpy(storage + payloadOffset, &value, sizeof(T));
+        }
+        
+        //! Store a string in place if it fits, or on the heap or in an arena otherwise, into a storage that holds no data yet
+        void constructString(std::string_view string, Arena* arena);
+        
+        //! Remember that elements of an array or object in an arena are given out, and may be changed
+        void markModified()
+        {
+            if (flags & inArena)
+                flags |= modified;
+        }
+        
+        //! Return the string that is stored
+        std::string_view getString() const;
+        
+        //! Return the array that is stored
+        Array& getArray() const { return *load<Array*>(); }
+        
+        //! Return the object that is stored
+        Object& getObject() const { return *load<Object*>(); }
+        
+        // Destructing and copying continue with these beyond maxRecursionDepth, comparing always uses
+        // them. They recurse up until maxRecursionDepth, and put values nested deeper than that aside
+        // in `deep` to be handled from there, so that deeply nested values can't overflow the stack.
+        
+        void destruct(std::size_t depth, std::vector<Value>& deep);
+        void destructNested(std::size_t depth, std::vector<Value>& deep);
+        void copyFrom(const Value& rhs, std::size_t depth, std::vector<std::pair<Value*, const Value*>>& deep);
+        static bool equals(const Value& lhs, const Value& rhs, std::size_t depth, std::vector<std::pair<const Value*, const Value*>>& deep);
 
 	private:
         //! The type that describes the current content
         Type type = Type::NIL;
         
-        union
-        {
-            bool boolean;
-            int64_t signedInt;
-            uint64_t unsignedInt;
-            long double real;
-            std::string string;
-            std::unique_ptr<Array> array;
-            std::unique_ptr<Object> object;
-        };
+        //! The size of a string stored in place, or longString for one that is stored on the heap
+        std::uint8_t stringSize = 0;
+        
+        //! How the long string, array or object is allocated (see inArena and modified)
+        std::uint8_t flags = 0;
+        
+        //! The characters of a short string, or at payloadOffset a number, a boolean, or a pointer to the
+        //! long string, array or object. Those are copied in and out with memcpy, which compiles to plain moves.
+        char storage[storageSize];
 	};
 
 	//! Compare two values for equality
@@ -10,13 +10,56 @@
 #include <iomanip>
 #include <sstream>
 #include <string>
+#include <vector>
 
+#include "simd.hpp"
 #include "writer.hpp"
 
 using namespace std;
 
 namespace json
 {
+    //! Write a string to stream, quoted and escaped
+    static void writeString(ostream& stream, std::string_view string)
+    {
+        static constexpr char hexDigits[] = "0123456789abcdef";
+        
+        stream << '"';
+        
+        const auto* begin = string.data();
+        const auto* end = begin + string.size();
+        while (begin != end)
+        {
+            // Write everything up until the next character that needs escaping at once
+            const auto* special = findStringSpecial(begin, end);
+            stream.write(begin, special - begin);
+            
+            if (special == end)
+                break;
+            
+            switch (const auto c = *special)
+            {
+                case '"': stream << "\\\""; break;
+                case '\\': stream << "\\\\"; break;
+                case '\b': stream << "\\b"; break;
+                case '\f': stream << "\\f"; break;
+                case '\n': stream << "\\n"; break;
+                case '\r': stream << "\\r"; break;
+                case '\t': stream << "\\t"; break;
+                default:
+                {
+                    const auto byte = static_cast<unsigned char>(c);
+                    const char escaped[] = { '\\', 'u', '0', '0', hexDigits[byte >> 4], hexDigits[byte & 0xF] };
+                    stream.write(escaped, sizeof(escaped));
+                    break;
+                }
+            }
+            
+            begin = special + 1;
+        }
+        
+        stream << '"';
+    }
     
 // --- Writer --- //
     
@@ -29,9 +72,59 @@ namespace json
     
 // --- LeanWriter --- //
     
+    //! An array or object that is being written, with the position of the next element
+    struct WriterFrame
+    {
+        Value::ConstIterator next;
+        Value::ConstIterator end;
+        bool isObject = false;
+        bool first = true;
+    };
+    
     void LeanWriter::writeToStream(ostream& stream, const Value& value) const
     {
-        if (value.isNull())
+        if (value.isArray() || value.isObject())
+        {
+            // Nesting is tracked with an explicit stack instead of recursion, so that deeply nested values can't overflow the call stack
+            vector<WriterFrame> stack;
+            stack.push_back({value.begin(), value.end(), value.isObject()});
+            stream << (value.isObject() ? '{' : '[');
+            
+            while (!stack.empty())
+            {
+                auto& frame = stack.back();
+                if (frame.next == frame.end)
+                {
+                    stream << (frame.isObject ? '}' : ']');
+                    stack.pop_back();
+                    continue;
+                }
+                
+                if (!frame.first)
+                    stream << ',';
+                
+                frame.first = false;
+                
+                auto accessor = *frame.next;
+                ++frame.next;
+                
+                if (frame.isObject)
+                {
+                    writeString(stream, accessor.key());
+                    stream << ':';
+                }
+                
+                const auto& element = accessor.value();
+                if (element.isArray() || element.isObject())
+                {
+                    stream << (element.isObject() ? '{' : '[');
+                    stack.push_back({element.begin(), element.end(), element.isObject()});
+                } else {
+                    writeToStream(stream, element);
+                }
+            }
+        }
+        else if (value.isNull())
             stream << "null";
         else if (value.isBool())
             stream << (value.asBool() ? "true" : "false");
@@ -55,34 +148,7 @@ namespace json
             
             stream << str;
         } else if (value.isString()) {
-            stream << std::quoted(value.asString());
-        } else if (value.isArray()) {
-            stream << '[';
-            
-            const auto size = value.size();
-            for (std::size_t i = 0; i < size; ++i)
-            {
-                writeToStream(stream, value[i]);
-                if (i != size - 1)
-                    stream << ',';
-            }
-            
-            stream << ']';
-        } else if (value.isObject()) {
-            stream << '{';
-            
-            const auto size = value.size();
-            const auto keys = value.keys();
-            for (std::size_t i = 0; i < size; ++i)
-            {
-                stream << std::quoted(keys[i]) << ":";
-                writeToStream(stream, value[keys[i]]);
-                
-                if (i != size - 1)
-                    stream << ',';
-            }
-            
-            stream << '}';
+            writeString(stream, value.asString());
         }
     }
     
@@ -90,67 +156,59 @@ namespace json
     
     void PrettyWriter::writeToStream(ostream& stream, const Value& value) const
     {
-        writeToStreamWithIndentation(stream, value, 0);
-    }
-    
-    void PrettyWriter::writeToStreamWithIndentation(ostream& stream, const Value& value, unsigned int indentation) const
-    {
-        if (value.isArray())
+        if (!value.isArray() && !value.isObject())
+            return LeanWriter::writeToStream(stream, value);
+        
+        // Nesting is tracked with an explicit stack instead of recursion, so that deeply nested values can't overflow the call stack
+        vector<WriterFrame> stack;
+        const auto* next = &value;
+        
+        while (true)
         {
-            if (value.empty())
+            if (next)
             {
-                stream << "[]";
-                return;
+                if (next->isArray() && next->empty())
+                    stream << "[]";
+                else if (next->isObject() && next->empty())
+                    stream << "{}";
+                else if (next->isArray() || next->isObject())
+                {
+                    stream << (next->isObject() ? '{' : '[');
+                    stack.push_back({next->begin(), next->end(), next->isObject()});
+                } else {
+                    LeanWriter::writeToStream(stream, *next);
+                }
+                
+                next = nullptr;
             }
             
-            stream << "[\n";
-            ++indentation;
+            if (stack.empty())
+                return;
             
-            const auto size = value.size();
-            for (std::size_t i = 0; i < size; ++i)
+            auto& frame = stack.back();
+            if (frame.next == frame.end)
             {
-                writeIndentation(stream, indentation);
-                writeToStreamWithIndentation(stream, value[i], indentation);
-                if (i != size - 1)
-                    stream << ',';
-                
                 stream << '\n';
+                writeIndentation(stream, static_cast<unsigned int>(stack.size() - 1));
+                stream << (frame.isObject ? '}' : ']');
+                stack.pop_back();
+                continue;
             }
             
-            --indentation;
-            writeIndentation(stream, indentation);
-            
-            stream << ']';
-        } else if (value.isObject()) {
-            if (value.empty())
-            {
-                stream << "{}";
-                return;
-            }
+            stream << (frame.first ? "\n" : ",\n");
+            frame.first = false;
+            writeIndentation(stream, static_cast<unsigned int>(stack.size()));
             
-            stream << "{\n";
-            ++indentation;
+            auto accessor = *frame.next;
+            ++frame.next;
             
-            const auto size = value.size();
-            const auto keys = value.keys();
-            for (std::size_t i = 0; i < size; ++i)
+            if (frame.isObject)
             {
-                writeIndentation(stream, indentation);
-                stream << std::quoted(keys[i]) << ": ";
-                writeToStreamWithIndentation(stream, value[keys[i]], indentation);
-                
-                if (i != size - 1)
-                    stream << ',';
-                
-                stream << '\n';
+                writeString(stream, accessor.key());
+                stream << ": ";
             }
             
-            --indentation;
-            writeIndentation(stream, indentation);
-            
-            stream << '}';
-        } else {
-            return LeanWriter::writeToStream(stream, value);
+            next = &accessor.value();
         }
     }
     
@@ -52,9 +52,6 @@ namespace json
         void writeToStream(std::ostream& stream, const Value& value) const override;
         
     private:
-        //! Write a Json value to stream using indentation
-        void writeToStreamWithIndentation(std::ostream& stream, const Value& value, unsigned int indentation) const;
-        
         //! Output a number of whitespaces for indentation
         void writeIndentation(std::ostream& stream, unsigned int indentation) const;
     };